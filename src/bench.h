@@ -0,0 +1,107 @@
+// bench.h
+// Resultados de rendimiento en formato legible por máquina. Cada programa
+// mide una muestra de tiempo por repetición y, si la variable de entorno
+// BENCH_FORMAT vale "csv" o "json", añade una línea con sus estadísticas
+// (mínimo, mediana, percentil 95, media y rendimiento) al archivo de
+// BENCH_OUTPUT o a la salida estándar. BENCH_WARMUP=k descarta las k
+// primeras muestras como calentamiento.
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Descripción de una medición
+typedef struct {
+    const char *program;   // nombre del programa
+    const char *variant;   // algoritmo, núcleo u operación
+    const char *config;    // entrada y parámetros que no cambian en el barrido
+    int procs;             // procesos MPI
+    int threads;           // hilos por proceso
+    double size;           // tamaño del problema (elementos, píxeles o N)
+    double work;           // trabajo por muestra: bytes u operaciones
+    const char *unit;      // "GB/s" o "GFLOP/s" (work / tiempo * 1e-9)
+} BenchInfo;
+
+static int bench_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Escribir una cadena entre comillas, duplicando las comillas internas (CSV)
+// o escapándolas (JSON)
+static void bench_quote(FILE *out, const char *text, int json) {
+    fputc('"', out);
+    for (const char *c = text ? text : ""; *c; c++) {
+        if (*c == '"') fputs(json ? "\\\"" : "\"\"", out);
+        else if (*c == '\\' && json) fputs("\\\\", out);
+        else fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+// Calcular las estadísticas de 'count' muestras (en segundos) y escribirlas.
+// No hace nada si BENCH_FORMAT no está definida.
+static void bench_report(const BenchInfo *info, const double *samples, int count) {
+    const char *format = getenv("BENCH_FORMAT");
+    if (format == NULL) return;
+    int json = (strcmp(format, "json") == 0);
+    if (!json && strcmp(format, "csv") != 0) return;
+
+    const char *warmupText = getenv("BENCH_WARMUP");
+    int warmup = warmupText ? atoi(warmupText) : 0;
+    if (warmup < 0 || warmup >= count) warmup = 0;
+    int n = count - warmup;
+    if (n <= 0) return;
+
+    double *sorted = malloc(n * sizeof(double));
+    memcpy(sorted, samples + warmup, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), bench_compare);
+
+    // Mediana y percentil 95 por rango más cercano
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += sorted[i];
+    double median = (n % 2) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    int p95Index = (int)(0.95 * n + 0.999999) - 1;
+    double p95 = sorted[p95Index < 0 ? 0 : p95Index];
+    double throughput = median > 0 ? info->work / median * 1e-9 : 0.0;
+
+    const char *path = getenv("BENCH_OUTPUT");
+    FILE *out = path ? fopen(path, "a") : stdout;
+    if (out == NULL) {
+        fprintf(stderr, "No se pudo abrir %s\n", path);
+        free(sorted);
+        return;
+    }
+
+    if (json) {
+        fputs("{\"program\": ", out); bench_quote(out, info->program, 1);
+        fputs(", \"variant\": ", out); bench_quote(out, info->variant, 1);
+        fputs(", \"config\": ", out); bench_quote(out, info->config, 1);
+        fprintf(out, ", \"procs\": %d, \"threads\": %d, \"size\": %.0f, \"samples\": %d, "
+                     "\"min_s\": %.9f, \"median_s\": %.9f, \"p95_s\": %.9f, \"mean_s\": %.9f, "
+                     "\"throughput\": %.6f, \"unit\": ",
+                info->procs, info->threads, info->size, n, sorted[0], median, p95, sum / n, throughput);
+        bench_quote(out, info->unit, 1);
+        fputs("}\n", out);
+    } else {
+        // Encabezado solo al empezar un archivo nuevo o, en la salida
+        // estándar, con la primera línea
+        static int headerWritten = 0;
+        if ((out == stdout && !headerWritten) || (out != stdout && ftell(out) == 0)) {
+            headerWritten = 1;
+            fputs("program,variant,config,procs,threads,size,samples,min_s,median_s,p95_s,mean_s,throughput,unit\n", out);
+        }
+        bench_quote(out, info->program, 0); fputc(',', out);
+        bench_quote(out, info->variant, 0); fputc(',', out);
+        bench_quote(out, info->config, 0);
+        fprintf(out, ",%d,%d,%.0f,%d,%.9f,%.9f,%.9f,%.9f,%.6f,%s\n",
+                info->procs, info->threads, info->size, n, sorted[0], median, p95, sum / n, throughput, info->unit);
+    }
+
+    if (out != stdout) fclose(out);
+    free(sorted);
+}
+
+#endif // BENCH_H
@@ -0,0 +1,223 @@
+#!/usr/bin/env bash
+# benchmark.sh
+# Compila los programas con el Makefile y ejecuta barridos de escalabilidad fuerte (tamaño
+# fijo) y débil (trabajo fijo por proceso o hilo) de los filtros Sobel, la
+# multiplicación de matrices, la reducción y el producto disperso. Cada
+# programa añade sus estadísticas con bench.h; al final se calculan la
+# aceleración y la eficiencia respecto a la ejecución con un solo proceso e
+# hilo de la misma serie. La serie fuerte recorre todos los tamaños de -n
+# (N de las matrices), -e (elementos de la reducción) y -g (lado de la malla
+# del Laplaciano); la débil parte del primero de cada lista.
+#
+# Uso: ./benchmark.sh [-o resultados.csv] [-j resultados.json] [-l etiqueta]
+#                     [-r repeticiones] [-w calentamiento] [-p "1 2 4"]
+#                     [-t "1 2 4"] [-s fuerte|debil|ambos] [-q]
+#                     [-n "512 1024 2048"] [-e "10000000"] [-g "300 2000"]
+#
+# Variables de entorno: CONFIG (release, debug, sanitize o pgo; por defecto
+# release), LTO y HYBRID, con el mismo significado que en el Makefile; con
+# HYBRID=1 sobel_mpi recorre también los hilos de -t. MPIRUN
+# (por defecto "mpirun"), NP, CC, MPICC y CFLAGS pasan al Makefile. La
+# etiqueta por defecto es el nombre del directorio de los binarios.
+set -euo pipefail
+
+cd "$(dirname "$0")"
+
+OUTPUT=resultados.csv
+JSON=""
+LABEL=""
+REPS=5
+WARMUP=1
+PROCS="1 2 4"
+THREADS="1 2 4"
+SWEEPS=ambos
+QUICK=0
+MATRIX_SIZES=""
+SUM_SIZES=""
+SPARSE_SIZES=""
+
+while getopts "o:j:l:r:w:p:t:s:qn:e:g:" opt; do
+    case $opt in
+        o) OUTPUT=$OPTARG ;;
+        j) JSON=$OPTARG ;;
+        l) LABEL=$OPTARG ;;
+        r) REPS=$OPTARG ;;
+        w) WARMUP=$OPTARG ;;
+        p) PROCS=$OPTARG ;;
+        t) THREADS=$OPTARG ;;
+        s) SWEEPS=$OPTARG ;;
+        q) QUICK=1 ;;
+        n) MATRIX_SIZES=$OPTARG ;;
+        e) SUM_SIZES=$OPTARG ;;
+        g) SPARSE_SIZES=$OPTARG ;;
+        *) sed -n '12,15p' "$0" >&2; exit 1 ;;
+    esac
+done
+
+export MPIRUN=${MPIRUN:-mpirun}
+CONFIG=${CONFIG:-release}
+HYBRID=${HYBRID:-0}
+MAKE_VARS=(LTO="${LTO:-0}" HYBRID="$HYBRID" TRACE=0)
+
+# Tamaños por defecto; -q los reduce para una comprobación rápida
+if [ "$QUICK" = 1 ]; then
+    MATRIX_SIZES=${MATRIX_SIZES:-256}; SUM_SIZES=${SUM_SIZES:-10000000}; SPARSE_SIZES=${SPARSE_SIZES:-300}
+else
+    MATRIX_SIZES=${MATRIX_SIZES:-2048}; SUM_SIZES=${SUM_SIZES:-400000000}; SPARSE_SIZES=${SPARSE_SIZES:-2000}
+fi
+# Base de la serie débil: el primer tamaño de cada lista
+read -r MATRIX_N _ <<< "$MATRIX_SIZES"
+read -r SUM_N _ <<< "$SUM_SIZES"
+read -r SPARSE_G _ <<< "$SPARSE_SIZES"
+
+# PGO tiene su propio objetivo, que entrena y recompila
+BIN=$(make -s CONFIG="$CONFIG" "${MAKE_VARS[@]}" builddir)
+echo "Compilando en $BIN"
+if [ "$CONFIG" = pgo ]; then
+    make "${MAKE_VARS[@]}" pgo
+else
+    make CONFIG="$CONFIG" "${MAKE_VARS[@]}"
+fi
+LABEL=${LABEL:-$(basename "$BIN")}
+
+# Hilos de sobel_mpi, que solo usa OpenMP con HYBRID=1 (matrices lo usa en
+# Strassen, pero el barrido mide SUMMA)
+MPI_THREADS=1
+if [ "$HYBRID" = 1 ]; then
+    MPI_THREADS=$THREADS
+fi
+
+WORK=$(mktemp -d)
+RAW=$WORK/todos.csv
+trap 'rm -rf "$WORK"' EXIT
+
+export BENCH_FORMAT=csv BENCH_OUTPUT=$WORK/run.csv BENCH_WARMUP=$WARMUP
+REPEAT=$((REPS + WARMUP))
+SWEEP=fuerte
+: > "$RAW"
+
+# Pasar las líneas de la última ejecución al archivo crudo, precedidas por
+# la serie a la que pertenecen
+collect() {
+    if [ -f "$BENCH_OUTPUT" ]; then
+        tail -n +2 "$BENCH_OUTPUT" | sed "s/^/$SWEEP,/" >> "$RAW"
+        rm -f "$BENCH_OUTPUT"
+    fi
+}
+
+# Ejecutar un programa MPI con p procesos de t hilos, pasando las variables
+# de bench.h
+run_mpi() {
+    local p=$1 t=$2; shift 2
+    OMP_NUM_THREADS=$t $MPIRUN -np "$p" -x BENCH_FORMAT -x BENCH_OUTPUT -x BENCH_WARMUP -x OMP_NUM_THREADS \
+        "$@" > /dev/null
+    collect
+}
+
+run_local() {
+    "$@" > /dev/null
+    collect
+}
+
+# Raíz entera de orden k de x*p, redondeada
+scale() {
+    awk -v b="$1" -v p="$2" -v k="$3" 'BEGIN { printf "%d", b * p ^ (1 / k) + 0.5 }'
+}
+
+mkdir -p "$WORK/out"
+run_local "$BIN/sobel_serial" -r "$REPEAT" -o "$WORK/out" images/
+
+if [ "$SWEEPS" != debil ]; then
+    SWEEP=fuerte
+    echo "Escalabilidad fuerte"
+    for t in $THREADS; do
+        run_local "$BIN/sobel_openmp" -p "$t" -r "$REPEAT" -o "$WORK/out" images/
+    done
+    for p in $PROCS; do
+        for t in $MPI_THREADS; do
+            run_mpi "$p" "$t" "$BIN/sobel_mpi" -m split -r "$REPEAT" -o "$WORK/out" images/
+        done
+        for n in $MATRIX_SIZES; do
+            run_mpi "$p" 1 "$BIN/matrices" -n "$n" -i "$REPEAT" -d
+        done
+        for n in $SUM_SIZES; do
+            run_mpi "$p" 1 "$BIN/sum_mpi" -n "$n" -i "$REPEAT"
+        done
+        for g in $SPARSE_SIZES; do
+            run_mpi "$p" 1 "$BIN/sparse_mpi" -g "$g" -i "$REPEAT"
+        done
+    done
+fi
+
+if [ "$SWEEPS" != fuerte ]; then
+    # El trabajo crece con p: n^3 en matrices, n en la reducción, g^2 en
+    # el Laplaciano y, en Sobel, p copias del lote en modo granja (una por
+    # proceso). Las versiones serie y OpenMP trabajan sobre una imagen y no
+    # tienen serie débil
+    SWEEP=debil
+    echo "Escalabilidad débil"
+    for p in $PROCS; do
+        batch=$WORK/debil/$p
+        mkdir -p "$batch"
+        for ((copy = 1; copy <= p; copy++)); do
+            for image in images/*.bmp; do
+                ln -sf "$PWD/$image" "$batch/c${copy}_$(basename "$image")"
+            done
+        done
+        run_mpi "$p" 1 "$BIN/sobel_mpi" -m farm -r "$REPEAT" -o "$WORK/out" "$batch"
+        run_mpi "$p" 1 "$BIN/matrices" -n "$(scale "$MATRIX_N" "$p" 3)" -i "$REPEAT" -d
+        run_mpi "$p" 1 "$BIN/sum_mpi" -n "$((SUM_N * p))" -i "$REPEAT"
+        run_mpi "$p" 1 "$BIN/sparse_mpi" -g "$(scale "$SPARSE_G" "$p" 2)" -i "$REPEAT"
+    done
+fi
+
+# Calcular aceleración y eficiencia frente a la ejecución con
+# procs * threads == 1 de la misma serie, programa, variante y configuración
+# (y tamaño en la serie fuerte). En la serie débil la configuración de
+# sobel_mpi empieza con el número de imágenes, que crece con p
+awk -F, -v label="$LABEL" '
+    {
+        line[NR] = $0
+        units = $5 * $6
+        config = $4
+        if ($1 == "debil") sub(/^"?[0-9]+ /, "", config)
+        key[NR] = $1 FS $2 FS $3 FS config ($1 == "fuerte" ? FS $7 : "")
+        median[NR] = $10
+        if (units == 1) base[key[NR]] = $10
+    }
+    END {
+        print "build,sweep,program,variant,config,procs,threads,size,samples,min_s,median_s,p95_s,mean_s,throughput,unit,speedup,efficiency"
+        for (i = 1; i <= NR; i++) {
+            split(line[i], f, FS)
+            units = f[5] * f[6]
+            speedup = ""; efficiency = ""
+            if ((key[i] in base) && median[i] > 0) {
+                ratio = base[key[i]] / median[i]
+                if (f[1] == "fuerte") { speedup = ratio; efficiency = ratio / units }
+                else { efficiency = ratio; speedup = ratio * units }
+                speedup = sprintf("%.3f", speedup); efficiency = sprintf("%.3f", efficiency)
+            }
+            print "\"" label "\"," line[i] "," speedup "," efficiency
+        }
+    }' "$RAW" > "$OUTPUT"
+
+echo "Resultados en $OUTPUT"
+
+# Versión JSON: un arreglo con un objeto por línea del CSV
+if [ -n "$JSON" ]; then
+    awk -F, '
+        NR == 1 { n = split($0, name, FS); print "["; next }
+        {
+            if (NR > 2) print ","
+            printf "  {"
+            for (i = 1; i <= n; i++) {
+                value = $i
+                if (value == "") value = "null"
+                else if (value !~ /^"/ && value !~ /^-?[0-9.e+-]+$/) value = "\"" value "\""
+                printf "%s\"%s\": %s", (i > 1 ? ", " : ""), name[i], value
+            }
+            printf "}"
+        }
+        END { print "\n]" }' "$OUTPUT" > "$JSON"
+    echo "Resultados en $JSON"
+fi
@@ -0,0 +1,405 @@
+// bmp_io.c
+// Implementación del módulo común de E/S de imágenes BMP con mmap.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bmp_io.h"
+
+// Comprobar que los encabezados describen un BMP de 24 bits sin compresión
+// cuyos píxeles caben en un archivo de 'fileSize' bytes
+static int bmp_validate(const BMPHeader *header, const BMPInfoHeader *infoHeader, size_t fileSize) {
+    if (header->type != 0x4D42) return BMP_ERR_FORMAT;
+    if (infoHeader->bitCount != 24 || infoHeader->compression != 0) return BMP_ERR_FORMAT;
+    if (infoHeader->width <= 0 || infoHeader->height == 0) return BMP_ERR_FORMAT;
+    if (header->offset < sizeof(BMPHeader) + sizeof(BMPInfoHeader)) return BMP_ERR_FORMAT;
+
+    size_t dataSize = (size_t)bmp_row_size(infoHeader->width) * (size_t)abs(infoHeader->height);
+    if (fileSize < header->offset || fileSize - header->offset < dataSize) return BMP_ERR_FORMAT;
+    return BMP_OK;
+}
+
+// Completar los campos derivados de los encabezados
+static void bmp_fill_geometry(BMPImage *image) {
+    image->width = image->infoHeader.width;
+    image->height = abs(image->infoHeader.height);
+    image->rowSize = bmp_row_size(image->width);
+    image->dataSize = (size_t)image->rowSize * image->height;
+}
+
+int bmp_read_header(const char *path, BMPHeader *header, BMPInfoHeader *infoHeader) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return BMP_ERR_OPEN;
+
+    struct stat st;
+    int result = BMP_ERR_FORMAT;
+    if (fstat(fd, &st) == 0 &&
+        pread(fd, header, sizeof(BMPHeader), 0) == sizeof(BMPHeader) &&
+        pread(fd, infoHeader, sizeof(BMPInfoHeader), sizeof(BMPHeader)) == sizeof(BMPInfoHeader)) {
+        result = bmp_validate(header, infoHeader, st.st_size);
+    }
+
+    close(fd);
+    return result;
+}
+
+int bmp_map(const char *path, BMPImage *image) {
+    memset(image, 0, sizeof(BMPImage));
+    image->fd = -1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return BMP_ERR_OPEN;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BMPHeader) + sizeof(BMPInfoHeader)) {
+        close(fd);
+        return BMP_ERR_FORMAT;
+    }
+
+    unsigned char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return BMP_ERR_MAP;
+    }
+
+    memcpy(&image->header, map, sizeof(BMPHeader));
+    memcpy(&image->infoHeader, map + sizeof(BMPHeader), sizeof(BMPInfoHeader));
+    int result = bmp_validate(&image->header, &image->infoHeader, st.st_size);
+    if (result != BMP_OK) {
+        munmap(map, st.st_size);
+        close(fd);
+        return result;
+    }
+
+    // Los filtros recorren la imagen por filas de principio a fin
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    // Solo tiene efecto si el sistema admite páginas grandes para archivos
+    madvise(map, st.st_size, MADV_HUGEPAGE);
+#endif
+
+    image->map = map;
+    image->mapSize = st.st_size;
+    image->fd = fd;
+    image->pixels = map + image->header.offset;
+    bmp_fill_geometry(image);
+    return BMP_OK;
+}
+
+int bmp_create(const char *path, const BMPImage *like, BMPImage *image) {
+    memset(image, 0, sizeof(BMPImage));
+    image->fd = -1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return BMP_ERR_OPEN;
+
+    size_t mapSize = like->header.offset + like->dataSize;
+    if (ftruncate(fd, mapSize) != 0) {
+        close(fd);
+        return BMP_ERR_MAP;
+    }
+
+    unsigned char *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return BMP_ERR_MAP;
+    }
+
+    // Copiar los encabezados completos (incluidas las extensiones V4/V5)
+    if (like->map != NULL) {
+        memcpy(map, like->map, like->header.offset);
+    } else {
+        memcpy(map, &like->header, sizeof(BMPHeader));
+        memcpy(map + sizeof(BMPHeader), &like->infoHeader, sizeof(BMPInfoHeader));
+    }
+
+    image->header = like->header;
+    image->infoHeader = like->infoHeader;
+    image->map = map;
+    image->mapSize = mapSize;
+    image->fd = fd;
+    image->pixels = map + like->header.offset;
+    bmp_fill_geometry(image);
+    return BMP_OK;
+}
+
+int bmp_write(const char *path, const BMPImage *like, const unsigned char *pixels) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) return BMP_ERR_OPEN;
+
+    int ok;
+    if (like->map != NULL) {
+        ok = fwrite(like->map, 1, like->header.offset, file) == like->header.offset;
+    } else {
+        ok = fwrite(&like->header, sizeof(BMPHeader), 1, file) == 1 &&
+             fwrite(&like->infoHeader, sizeof(BMPInfoHeader), 1, file) == 1 &&
+             fseek(file, like->header.offset, SEEK_SET) == 0;
+    }
+    ok = ok && fwrite(pixels, 1, like->dataSize, file) == like->dataSize;
+
+    if (fclose(file) != 0) ok = 0;
+    return ok ? BMP_OK : BMP_ERR_OPEN;
+}
+
+void bmp_unmap(BMPImage *image) {
+    if (image->map != NULL) {
+        munmap(image->map, image->mapSize);
+    }
+    if (image->fd >= 0) {
+        close(image->fd);
+    }
+    image->map = NULL;
+    image->pixels = NULL;
+    image->fd = -1;
+}
+
+void bmp_prefetch_rows(const BMPImage *image, int first, int count) {
+    if (image->map == NULL || count <= 0) return;
+
+    // madvise requiere una dirección alineada a página
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = image->header.offset + (size_t)first * image->rowSize;
+    size_t end = start + (size_t)count * image->rowSize;
+    size_t alignedStart = start & ~(pageSize - 1);
+    madvise(image->map + alignedStart, end - alignedStart, MADV_WILLNEED);
+}
+
+// Leer o escribir exactamente 'bytes' bytes desde 'offset'
+static int transfer_all(int fd, unsigned char *buffer, size_t bytes, off_t offset, int write) {
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = write ? pwrite(fd, buffer + done, bytes - done, offset + done)
+                          : pread(fd, buffer + done, bytes - done, offset + done);
+        if (n <= 0) return BMP_ERR_IO;
+        done += n;
+    }
+    return BMP_OK;
+}
+
+int bmp_write_rows(const BMPImage *image, int first, int count, const unsigned char *pixels) {
+    if (count <= 0) return BMP_OK;
+    off_t offset = image->header.offset + (off_t)first * image->rowSize;
+    return transfer_all(image->fd, (unsigned char *)pixels, (size_t)count * image->rowSize, offset, 1);
+}
+
+struct BMPReader {
+    int fd;
+    off_t offset;
+    int rowSize, height;
+    int band, halo, depth, bands;
+    unsigned char **buffer;     // 'depth' búferes de (band + halo) filas
+    int produced;               // bandas ya leídas
+    int released;               // bandas que el consumidor ya no usa
+    int stop, error;
+    int started;                // el hilo lector está en marcha
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+// Primera fila de la banda 'k', incluido su halo
+static int reader_first(const BMPReader *reader, int k) {
+    return k == 0 ? 0 : k * reader->band - reader->halo;
+}
+
+// Hilo lector: la banda k va al búfer k % depth en cuanto el consumidor
+// libera la banda k - depth que lo ocupaba
+static void *reader_main(void *arg) {
+    BMPReader *reader = arg;
+
+    for (int k = 0; k < reader->bands; k++) {
+        pthread_mutex_lock(&reader->lock);
+        while (!reader->stop && k - reader->released >= reader->depth) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        int stop = reader->stop;
+        pthread_mutex_unlock(&reader->lock);
+        if (stop) break;
+
+        // El halo se copia del búfer de la banda anterior, que el hilo lector
+        // no reutiliza hasta la banda k - 1 + depth
+        unsigned char *buffer = reader->buffer[k % reader->depth];
+        size_t rowSize = reader->rowSize;
+        int start = k * reader->band;
+        int end = (start + reader->band < reader->height) ? start + reader->band : reader->height;
+        size_t carried = 0;
+        if (k > 0) {
+            const unsigned char *previous = reader->buffer[(k - 1) % reader->depth];
+            carried = (size_t)reader->halo * rowSize;
+            memcpy(buffer, previous + (size_t)(start - reader_first(reader, k - 1)) * rowSize - carried, carried);
+        }
+        int result = transfer_all(reader->fd, buffer + carried, (size_t)(end - start) * rowSize,
+                                  reader->offset + (off_t)start * rowSize, 0);
+
+        pthread_mutex_lock(&reader->lock);
+        if (result != BMP_OK) reader->error = 1;
+        else reader->produced = k + 1;
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+        if (result != BMP_OK) break;
+    }
+    return NULL;
+}
+
+BMPReader *bmp_reader_open(const BMPImage *image, int band, int halo, int depth) {
+    if (band < 1 || halo < 0 || halo > band || depth < 2) return NULL;
+
+    BMPReader *reader = calloc(1, sizeof(BMPReader));
+    if (reader == NULL) return NULL;
+    reader->fd = image->fd;
+    reader->offset = image->header.offset;
+    reader->rowSize = image->rowSize;
+    reader->height = image->height;
+    reader->band = band;
+    reader->halo = halo;
+    reader->depth = depth;
+    reader->bands = (image->height + band - 1) / band;
+    reader->released = -1;
+    reader->buffer = calloc(depth, sizeof(unsigned char *));
+
+    int failed = (reader->buffer == NULL);
+    for (int i = 0; i < depth && !failed; i++) {
+        reader->buffer[i] = malloc((size_t)(band + halo) * image->rowSize);
+        failed = (reader->buffer[i] == NULL);
+    }
+
+    // Las bandas se piden en orden: el sistema puede leer por adelantado
+    posix_fadvise(reader->fd, reader->offset, image->dataSize, POSIX_FADV_SEQUENTIAL);
+
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+    reader->started = !failed && pthread_create(&reader->thread, NULL, reader_main, reader) == 0;
+    if (!reader->started) {
+        bmp_reader_close(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+const unsigned char *bmp_reader_next(BMPReader *reader, int *first, int *rows) {
+    pthread_mutex_lock(&reader->lock);
+    int k = ++reader->released;
+    pthread_cond_broadcast(&reader->changed);
+    while (!reader->error && k < reader->bands && reader->produced <= k) {
+        pthread_cond_wait(&reader->changed, &reader->lock);
+    }
+    int ready = !reader->error && k < reader->bands;
+    pthread_mutex_unlock(&reader->lock);
+    if (!ready) return NULL;
+
+    int end = (k + 1) * reader->band;
+    *first = reader_first(reader, k);
+    *rows = (end < reader->height ? end : reader->height) - *first;
+    return reader->buffer[k % reader->depth];
+}
+
+int bmp_reader_close(BMPReader *reader) {
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = 1;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    if (reader->started) pthread_join(reader->thread, NULL);
+
+    int result = reader->error ? BMP_ERR_IO : BMP_OK;
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->changed);
+    for (int i = 0; reader->buffer != NULL && i < reader->depth; i++) free(reader->buffer[i]);
+    free(reader->buffer);
+    free(reader);
+    return result;
+}
+
+const char *bmp_strerror(int code) {
+    switch (code) {
+        case BMP_OK: return "sin error";
+        case BMP_ERR_OPEN: return "no se pudo abrir o crear el archivo";
+        case BMP_ERR_FORMAT: return "el archivo no es un BMP de 24 bits válido";
+        case BMP_ERR_MAP: return "no se pudo proyectar el archivo en memoria";
+        case BMP_ERR_IO: return "falló una lectura o escritura del archivo";
+        default: return "error desconocido";
+    }
+}
+
+// Comparar nombres de archivo para ordenar las entradas de un directorio
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Añadir a la lista una copia del nombre (solo los bytes que ocupa),
+// ampliándola si hace falta
+static void add_name(char ***list, int *count, int *capacity, const char *path) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *list = realloc(*list, *capacity * sizeof(char *));
+    }
+    (*list)[(*count)++] = strdup(path);
+}
+
+// Añadir a la lista los BMP de un directorio (en orden alfabético), omitiendo
+// las salidas generadas por los programas Sobel
+static void add_directory(const char *dir, char ***list, int *count, int *capacity) {
+    DIR *d = opendir(dir);
+    if (d == NULL) return;
+
+    int first = *count;
+    size_t dirLen = strlen(dir);
+    const char *separator = (dirLen > 0 && dir[dirLen - 1] == '/') ? "" : "/";
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while ((entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".bmp") != 0) continue;
+        if (strncmp(entry->d_name, "sobel_", 6) == 0) continue;
+        snprintf(path, sizeof(path), "%s%s%s", dir, separator, entry->d_name);
+        add_name(list, count, capacity, path);
+    }
+    closedir(d);
+
+    qsort(*list + first, *count - first, sizeof(char *), compare_names);
+}
+
+char **bmp_list_inputs(int argc, char *argv[], int first, int last, int *count) {
+    char **list = NULL;
+    int capacity = 0;
+    char path[PATH_MAX];
+    *count = 0;
+
+    if (argc == 0) {
+        for (int img = first; img <= last; img++) {
+            snprintf(path, sizeof(path), "images/%d.bmp", img);
+            add_name(&list, count, &capacity, path);
+        }
+    }
+    for (int i = 0; i < argc; i++) {
+        struct stat st;
+        if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            add_directory(argv[i], &list, count, &capacity);
+        } else {
+            snprintf(path, sizeof(path), "%s", argv[i]);
+            add_name(&list, count, &capacity, path);
+        }
+    }
+    return list;
+}
+
+void bmp_free_list(char **list, int count) {
+    for (int i = 0; i < count; i++) free(list[i]);
+    free(list);
+}
+
+void bmp_output_name(const char *input, const char *outputDir, const char *prefix, char *output) {
+    const char *base = strrchr(input, '/');
+    base = base ? base + 1 : input;
+
+    if (outputDir != NULL) {
+        snprintf(output, PATH_MAX, "%s/%s%s", outputDir, prefix, base);
+    } else {
+        snprintf(output, PATH_MAX, "%.*s%s%s", (int)(base - input), input, prefix, base);
+    }
+}
@@ -0,0 +1,123 @@
+// bmp_io.h
+// Módulo común de E/S de imágenes BMP de 24 bits para los programas Sobel.
+// Las imágenes se proyectan en memoria con mmap: los núcleos reciben un
+// puntero a los píxeles dentro de la proyección y el tamaño de fila
+// (stride), sin copias intermedias de la entrada ni de la salida.
+#ifndef BMP_IO_H
+#define BMP_IO_H
+
+#include <stddef.h>
+
+// Estructuras para manejar el encabezado BMP
+#pragma pack(push, 1)
+typedef struct {
+    unsigned short type;       // Tipo de archivo (debe ser 'BM' para un archivo BMP válido)
+    unsigned int size;         // Tamaño del archivo en bytes
+    unsigned short reserved1;
+    unsigned short reserved2;
+    unsigned int offset;       // Desplazamiento a los datos de píxeles
+} BMPHeader;
+
+typedef struct {
+    unsigned int size;           // Tamaño de esta estructura en bytes
+    int width;                   // Ancho de la imagen en píxeles
+    int height;                  // Altura de la imagen en píxeles
+    unsigned short planes;       // Número de planos de color (debe ser 1)
+    unsigned short bitCount;     // Número de bits por píxel
+    unsigned int compression;    // Método de compresión utilizado
+    unsigned int imageSize;      // Tamaño de los datos de imagen en bytes
+    int xPixelsPerMeter;         // Resolución horizontal en píxeles por metro
+    int yPixelsPerMeter;         // Resolución vertical en píxeles por metro
+    unsigned int colorsUsed;     // Número de colores en la paleta
+    unsigned int colorsImportant;// Número de colores importantes
+} BMPInfoHeader;
+#pragma pack(pop)
+
+// Códigos de error
+#define BMP_OK          0
+#define BMP_ERR_OPEN   -1   // no se pudo abrir o crear el archivo
+#define BMP_ERR_FORMAT -2   // no es un BMP de 24 bits sin compresión o está truncado
+#define BMP_ERR_MAP    -3   // falló mmap o el redimensionado del archivo
+#define BMP_ERR_IO     -4   // falló una lectura o escritura por bandas
+
+// Imagen BMP proyectada en memoria
+typedef struct {
+    BMPHeader header;
+    BMPInfoHeader infoHeader;
+    int width;               // Ancho en píxeles
+    int height;              // Alto en píxeles (valor absoluto)
+    int rowSize;             // Bytes por fila, alineados a 4 (stride)
+    size_t dataSize;         // rowSize * height
+    unsigned char *pixels;   // Primer píxel dentro de la proyección
+    unsigned char *map;      // Inicio de la proyección (el archivo completo)
+    size_t mapSize;
+    int fd;
+} BMPImage;
+
+// Bytes por fila de una imagen de 24 bits, alineados a 4 bytes
+static inline int bmp_row_size(int width) {
+    return (width * 3 + 3) & (~3);
+}
+
+// Leer y validar solo los encabezados de un archivo
+int bmp_read_header(const char *path, BMPHeader *header, BMPInfoHeader *infoHeader);
+
+// Proyectar una imagen en modo lectura. Los encabezados se validan una vez
+// aquí; los píxeles se leen bajo demanda a través de la caché de páginas.
+int bmp_map(const char *path, BMPImage *image);
+
+// Crear una imagen de salida del mismo tamaño que 'like', preasignada y
+// proyectada en modo lectura/escritura. Los encabezados (todo lo anterior a
+// los píxeles) se copian de 'like' y los píxeles empiezan a cero.
+int bmp_create(const char *path, const BMPImage *like, BMPImage *image);
+
+// Escribir una imagen con los encabezados de 'like' y los píxeles de un búfer
+int bmp_write(const char *path, const BMPImage *like, const unsigned char *pixels);
+
+// Liberar la proyección y cerrar el archivo
+void bmp_unmap(BMPImage *image);
+
+// Sugerir al sistema que lea por adelantado las filas [first, first + count)
+void bmp_prefetch_rows(const BMPImage *image, int first, int count);
+
+// Escribir con pwrite las 'count' filas de 'pixels' a partir de la fila
+// 'first' de una imagen creada con bmp_create, sin pasar por su proyección
+int bmp_write_rows(const BMPImage *image, int first, int count, const unsigned char *pixels);
+
+// Lectura de una imagen por bandas para procesarla sin tenerla completa en
+// memoria. Un hilo lee con pread, por adelantado, bandas de 'band' filas en
+// 'depth' búferes propios; cada banda empieza con las últimas 'halo' filas de
+// la anterior, copiadas de su búfer, para que los filtros tengan sus filas
+// vecinas. La memoria usada es depth * (band + halo) filas.
+typedef struct BMPReader BMPReader;
+
+// Empezar a leer 'image' (proyectada con bmp_map; sus píxeles se leen del
+// descriptor, no de la proyección). Requiere halo <= band y depth >= 2.
+BMPReader *bmp_reader_open(const BMPImage *image, int band, int halo, int depth);
+
+// Siguiente banda: devuelve sus píxeles, su primera fila (*first, incluido el
+// halo) y su número de filas (*rows), o NULL al terminar o si falla una
+// lectura. La banda devuelta antes deja de ser válida.
+const unsigned char *bmp_reader_next(BMPReader *reader, int *first, int *rows);
+
+// Detener la lectura y liberar los búferes. Devuelve BMP_ERR_IO si falló
+// alguna lectura.
+int bmp_reader_close(BMPReader *reader);
+
+// Construir la lista de imágenes a procesar a partir de los argumentos:
+// cada uno puede ser un archivo BMP o un directorio (se toman sus .bmp en
+// orden alfabético, omitiendo las salidas "sobel_*"). Sin argumentos se usan
+// images/first.bmp ... images/last.bmp. Devuelve un arreglo de *count
+// nombres que se libera con bmp_free_list.
+char **bmp_list_inputs(int argc, char *argv[], int first, int last, int *count);
+void bmp_free_list(char **list, int count);
+
+// Nombre del archivo de salida: 'outputDir' (o el directorio de la entrada)
+// seguido de 'prefix' y el nombre de la entrada. 'output' debe tener
+// PATH_MAX bytes.
+void bmp_output_name(const char *input, const char *outputDir, const char *prefix, char *output);
+
+// Mensaje asociado a un código de error
+const char *bmp_strerror(int code);
+
+#endif // BMP_IO_H
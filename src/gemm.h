@@ -0,0 +1,274 @@
+// gemm.h
+// Multiplicación de matrices local C += A * B con bloqueo por niveles de
+// caché y paneles empaquetados, especializada para int y double. El núcleo
+// interno (micro-kernel) calcula un bloque de MR x NR elementos de C en
+// registros; hay una versión escalar y versiones AVX2 (FMA para double),
+// seleccionadas en tiempo de ejecución según la CPU.
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEMM_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Tamaños de bloque. Cada panel de A (MC x KC) cabe en L2, cada panel de B
+// (KC x NC) en L3, y una tira de B (KC x NR) en L1 mientras se recorre A.
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 4080
+
+// Bloque de registros de cada tipo: 6 filas x 8 columnas double (12
+// registros AVX de 4 elementos) y 6 filas x 16 columnas int (12 de 8)
+#define GEMM_MR_double 6
+#define GEMM_NR_double 8
+#define GEMM_MR_int 6
+#define GEMM_NR_int 16
+
+// Búferes de empaquetado de cada hilo (los productos de Strassen se lanzan
+// como tareas OpenMP). Se reservan en la primera llamada y solo crecen, de
+// modo que los productos repetidos de SUMMA (uno por banda y panel) no
+// asignan memoria ni provocan fallos de página en cada llamada.
+typedef struct {
+    void *data;
+    size_t bytes;
+} GemmBuffer;
+
+static _Thread_local GemmBuffer gemm_packed_a, gemm_packed_b;
+
+// Devolver un búfer alineado a 64 bytes de al menos 'bytes' bytes
+static void *gemm_buffer(GemmBuffer *buffer, size_t bytes) {
+    bytes = (bytes + 63) & ~(size_t)63;
+    if (buffer->bytes < bytes) {
+        free(buffer->data);
+        buffer->data = aligned_alloc(64, bytes);
+        if (buffer->data == NULL) {
+            fprintf(stderr, "No se pudo asignar memoria para empaquetar los bloques del producto\n");
+            exit(1);
+        }
+        buffer->bytes = bytes;
+    }
+    return buffer->data;
+}
+
+// Micro-kernel: C[0..MR, 0..NR] += a * b, donde 'a' es una tira de A
+// empaquetada por columnas (MR elementos por paso) y 'b' una tira de B
+// empaquetada por filas (NR elementos por paso), ambas de longitud kc
+#define GEMM_KERNEL_ARGS(TYPE) int kc, const TYPE *a, const TYPE *b, TYPE *c, int ldc
+
+// Versión escalar del micro-kernel y rutinas de empaquetado y recorrido de
+// bloques para un tipo concreto
+#define GEMM_DEFINE(TYPE)                                                                   \
+    static void gemm_kernel_##TYPE##_scalar(GEMM_KERNEL_ARGS(TYPE)) {                       \
+        TYPE acc[GEMM_MR_##TYPE][GEMM_NR_##TYPE] = {{0}};                                   \
+        for (int p = 0; p < kc; p++) {                                                      \
+            for (int i = 0; i < GEMM_MR_##TYPE; i++) {                                      \
+                for (int j = 0; j < GEMM_NR_##TYPE; j++) {                                  \
+                    acc[i][j] += a[i] * b[j];                                               \
+                }                                                                           \
+            }                                                                               \
+            a += GEMM_MR_##TYPE;                                                            \
+            b += GEMM_NR_##TYPE;                                                            \
+        }                                                                                   \
+        for (int i = 0; i < GEMM_MR_##TYPE; i++) {                                          \
+            for (int j = 0; j < GEMM_NR_##TYPE; j++) {                                      \
+                c[(size_t)i * ldc + j] += acc[i][j];                                        \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    static void (*gemm_kernel_##TYPE)(GEMM_KERNEL_ARGS(TYPE)) = gemm_kernel_##TYPE##_scalar; \
+                                                                                            \
+    /* Empaquetar A[0..mc, 0..kc] en tiras de MR filas, rellenando con ceros */              \
+    static void gemm_pack_a_##TYPE(int mc, int kc, const TYPE *A, int lda, TYPE *packed) {  \
+        for (int i0 = 0; i0 < mc; i0 += GEMM_MR_##TYPE) {                                   \
+            int mr = (mc - i0 < GEMM_MR_##TYPE) ? mc - i0 : GEMM_MR_##TYPE;                 \
+            for (int p = 0; p < kc; p++) {                                                  \
+                for (int i = 0; i < GEMM_MR_##TYPE; i++) {                                  \
+                    *packed++ = (i < mr) ? A[(size_t)(i0 + i) * lda + p] : (TYPE)0;         \
+                }                                                                           \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    /* Empaquetar B[0..kc, 0..nc] en tiras de NR columnas, rellenando con ceros */           \
+    static void gemm_pack_b_##TYPE(int kc, int nc, const TYPE *B, int ldb, TYPE *packed) {  \
+        for (int j0 = 0; j0 < nc; j0 += GEMM_NR_##TYPE) {                                   \
+            int nr = (nc - j0 < GEMM_NR_##TYPE) ? nc - j0 : GEMM_NR_##TYPE;                 \
+            for (int p = 0; p < kc; p++) {                                                  \
+                const TYPE *row = B + (size_t)p * ldb + j0;                                 \
+                if (nr == GEMM_NR_##TYPE) {                                                 \
+                    memcpy(packed, row, sizeof(TYPE) * GEMM_NR_##TYPE);                     \
+                } else {                                                                    \
+                    for (int j = 0; j < GEMM_NR_##TYPE; j++) {                              \
+                        packed[j] = (j < nr) ? row[j] : (TYPE)0;                            \
+                    }                                                                       \
+                }                                                                           \
+                packed += GEMM_NR_##TYPE;                                                   \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    /* C (m x n) += A (m x k) * B (k x n), matrices en orden por filas */                    \
+    static void gemm_##TYPE(int m, int n, int k, const TYPE *A, int lda,                    \
+                            const TYPE *B, int ldb, TYPE *C, int ldc) {                     \
+        if (m <= 0 || n <= 0 || k <= 0) return;                                             \
+        int ncMax = (n < GEMM_NC) ? n : GEMM_NC;                                            \
+        int kcMax = (k < GEMM_KC) ? k : GEMM_KC;                                            \
+        int mcMax = (m < GEMM_MC) ? m : GEMM_MC;                                            \
+        size_t bSize = (size_t)kcMax * ((ncMax + GEMM_NR_##TYPE - 1) / GEMM_NR_##TYPE) * GEMM_NR_##TYPE; \
+        size_t aSize = (size_t)kcMax * ((mcMax + GEMM_MR_##TYPE - 1) / GEMM_MR_##TYPE) * GEMM_MR_##TYPE; \
+        TYPE *packedB = gemm_buffer(&gemm_packed_b, bSize * sizeof(TYPE));                  \
+        TYPE *packedA = gemm_buffer(&gemm_packed_a, aSize * sizeof(TYPE));                  \
+        TYPE edge[GEMM_MR_##TYPE * GEMM_NR_##TYPE];                                         \
+                                                                                            \
+        for (int jc = 0; jc < n; jc += GEMM_NC) {                                           \
+            int nc = (n - jc < GEMM_NC) ? n - jc : GEMM_NC;                                 \
+            for (int pc = 0; pc < k; pc += GEMM_KC) {                                       \
+                int kc = (k - pc < GEMM_KC) ? k - pc : GEMM_KC;                             \
+                gemm_pack_b_##TYPE(kc, nc, B + (size_t)pc * ldb + jc, ldb, packedB);        \
+                for (int ic = 0; ic < m; ic += GEMM_MC) {                                   \
+                    int mc = (m - ic < GEMM_MC) ? m - ic : GEMM_MC;                         \
+                    gemm_pack_a_##TYPE(mc, kc, A + (size_t)ic * lda + pc, lda, packedA);    \
+                    for (int jr = 0; jr < nc; jr += GEMM_NR_##TYPE) {                       \
+                        int nr = (nc - jr < GEMM_NR_##TYPE) ? nc - jr : GEMM_NR_##TYPE;     \
+                        const TYPE *b = packedB + (size_t)jr * kc;                          \
+                        for (int ir = 0; ir < mc; ir += GEMM_MR_##TYPE) {                   \
+                            int mr = (mc - ir < GEMM_MR_##TYPE) ? mc - ir : GEMM_MR_##TYPE; \
+                            const TYPE *a = packedA + (size_t)ir * kc;                      \
+                            TYPE *c = C + (size_t)(ic + ir) * ldc + jc + jr;                \
+                            if (mr == GEMM_MR_##TYPE && nr == GEMM_NR_##TYPE) {             \
+                                gemm_kernel_##TYPE(kc, a, b, c, ldc);                       \
+                            } else {                                                        \
+                                /* Bloque incompleto en el borde: calcular aparte */        \
+                                memset(edge, 0, sizeof(edge));                              \
+                                gemm_kernel_##TYPE(kc, a, b, edge, GEMM_NR_##TYPE);         \
+                                for (int i = 0; i < mr; i++) {                              \
+                                    for (int j = 0; j < nr; j++) {                          \
+                                        c[(size_t)i * ldc + j] += edge[i * GEMM_NR_##TYPE + j]; \
+                                    }                                                       \
+                                }                                                           \
+                            }                                                               \
+                        }                                                                   \
+                    }                                                                       \
+                }                                                                           \
+            }                                                                               \
+        }                                                                                   \
+    }
+
+GEMM_DEFINE(double)
+GEMM_DEFINE(int)
+
+#ifdef GEMM_SIMD_X86
+
+// Versión AVX2/FMA para double: cada fila del bloque 6 x 8 ocupa dos
+// registros de 4 elementos; en cada paso se cargan 8 elementos de B y se
+// difunde un elemento de A por fila.
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_double_avx2(GEMM_KERNEL_ARGS(double)) {
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+    __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+    for (int p = 0; p < kc; p++) {
+        __m256d b0 = _mm256_load_pd(b);
+        __m256d b1 = _mm256_load_pd(b + 4);
+        __m256d ai;
+        ai = _mm256_broadcast_sd(a + 0); c00 = _mm256_fmadd_pd(ai, b0, c00); c01 = _mm256_fmadd_pd(ai, b1, c01);
+        ai = _mm256_broadcast_sd(a + 1); c10 = _mm256_fmadd_pd(ai, b0, c10); c11 = _mm256_fmadd_pd(ai, b1, c11);
+        ai = _mm256_broadcast_sd(a + 2); c20 = _mm256_fmadd_pd(ai, b0, c20); c21 = _mm256_fmadd_pd(ai, b1, c21);
+        ai = _mm256_broadcast_sd(a + 3); c30 = _mm256_fmadd_pd(ai, b0, c30); c31 = _mm256_fmadd_pd(ai, b1, c31);
+        ai = _mm256_broadcast_sd(a + 4); c40 = _mm256_fmadd_pd(ai, b0, c40); c41 = _mm256_fmadd_pd(ai, b1, c41);
+        ai = _mm256_broadcast_sd(a + 5); c50 = _mm256_fmadd_pd(ai, b0, c50); c51 = _mm256_fmadd_pd(ai, b1, c51);
+        a += GEMM_MR_double;
+        b += GEMM_NR_double;
+    }
+
+#define GEMM_STORE_ROW_PD(i, lo, hi)                                                         \
+    _mm256_storeu_pd(c + (size_t)(i) * ldc, _mm256_add_pd(_mm256_loadu_pd(c + (size_t)(i) * ldc), lo)); \
+    _mm256_storeu_pd(c + (size_t)(i) * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(c + (size_t)(i) * ldc + 4), hi))
+    GEMM_STORE_ROW_PD(0, c00, c01);
+    GEMM_STORE_ROW_PD(1, c10, c11);
+    GEMM_STORE_ROW_PD(2, c20, c21);
+    GEMM_STORE_ROW_PD(3, c30, c31);
+    GEMM_STORE_ROW_PD(4, c40, c41);
+    GEMM_STORE_ROW_PD(5, c50, c51);
+#undef GEMM_STORE_ROW_PD
+}
+
+// Versión AVX2 para int: mismo esquema con bloques de 6 x 16 (dos registros
+// de 8 enteros por fila) y multiplicación de 32 bits (_mm256_mullo_epi32)
+__attribute__((target("avx2")))
+static void gemm_kernel_int_avx2(GEMM_KERNEL_ARGS(int)) {
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    __m256i c40 = _mm256_setzero_si256(), c41 = _mm256_setzero_si256();
+    __m256i c50 = _mm256_setzero_si256(), c51 = _mm256_setzero_si256();
+
+    for (int p = 0; p < kc; p++) {
+        __m256i b0 = _mm256_load_si256((const __m256i *)b);
+        __m256i b1 = _mm256_load_si256((const __m256i *)(b + 8));
+        __m256i ai;
+#define GEMM_UPDATE_ROW_EPI32(i, lo, hi)                                                     \
+        ai = _mm256_set1_epi32(a[i]);                                                       \
+        lo = _mm256_add_epi32(lo, _mm256_mullo_epi32(ai, b0));                              \
+        hi = _mm256_add_epi32(hi, _mm256_mullo_epi32(ai, b1))
+        GEMM_UPDATE_ROW_EPI32(0, c00, c01);
+        GEMM_UPDATE_ROW_EPI32(1, c10, c11);
+        GEMM_UPDATE_ROW_EPI32(2, c20, c21);
+        GEMM_UPDATE_ROW_EPI32(3, c30, c31);
+        GEMM_UPDATE_ROW_EPI32(4, c40, c41);
+        GEMM_UPDATE_ROW_EPI32(5, c50, c51);
+#undef GEMM_UPDATE_ROW_EPI32
+        a += GEMM_MR_int;
+        b += GEMM_NR_int;
+    }
+
+#define GEMM_STORE_ROW_EPI32(i, lo, hi)                                                      \
+    _mm256_storeu_si256((__m256i *)(c + (size_t)(i) * ldc),                                 \
+        _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(c + (size_t)(i) * ldc)), lo)); \
+    _mm256_storeu_si256((__m256i *)(c + (size_t)(i) * ldc + 8),                             \
+        _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(c + (size_t)(i) * ldc + 8)), hi))
+    GEMM_STORE_ROW_EPI32(0, c00, c01);
+    GEMM_STORE_ROW_EPI32(1, c10, c11);
+    GEMM_STORE_ROW_EPI32(2, c20, c21);
+    GEMM_STORE_ROW_EPI32(3, c30, c31);
+    GEMM_STORE_ROW_EPI32(4, c40, c41);
+    GEMM_STORE_ROW_EPI32(5, c50, c51);
+#undef GEMM_STORE_ROW_EPI32
+}
+
+#endif // GEMM_SIMD_X86
+
+// Seleccionar los micro-kernels más rápidos soportados por la CPU. La
+// variable de entorno GEMM_SIMD=scalar fuerza la versión escalar.
+static void gemm_select(const char **name) {
+    const char *forced = getenv("GEMM_SIMD");
+    const char *kernelName = "scalar";
+
+#ifdef GEMM_SIMD_X86
+    __builtin_cpu_init();
+    if (!(forced && strcmp(forced, "scalar") == 0)) {
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            gemm_kernel_double = gemm_kernel_double_avx2;
+            gemm_kernel_int = gemm_kernel_int_avx2;
+            kernelName = "avx2";
+        }
+    }
+#else
+    (void)forced;
+#endif
+
+    if (name) *name = kernelName;
+}
+
+#endif // GEMM_H
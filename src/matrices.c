@@ -1,140 +1,804 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
 #include <sys/resource.h>
+#include "gemm.h"
+#include "bench.h"
+#include "mpi_trace.h"
 
-#define MATRIX_SIZE 4  // Dimensión de las matrices
+#define DEFAULT_MATRIX_SIZE 4   // Dimensión por defecto de las matrices
+#define DISPLAY_LIMIT 16        // Tamaño máximo para mostrar el resultado recolectado
+#define INIT_MODULUS 100        // Los valores iniciales van de 1 a INIT_MODULUS
+#define DEFAULT_PANEL GEMM_KC   // Ancho máximo de los paneles de SUMMA
+#define CHECK_SAMPLES 16        // Elementos verificados por proceso con -c
+#define BAND_ROWS (4 * GEMM_MC) // Filas de C entre comprobaciones de la difusión en curso
+#define DEFAULT_STRASSEN_CUTOFF 256 // Tamaño de bloque a partir del cual Strassen usa el producto clásico
+#define STRASSEN_TASK_DEPTH 2   // Niveles de Strassen en los que los productos son tareas OpenMP
+#define SUMMA_TOLERANCE 1e-9    // Error relativo admitido al verificar con SUMMA
+#define STRASSEN_TOLERANCE 1e-6 // Strassen acumula más error de redondeo en double
 
-// Función para inicializar una matriz con valores secuenciales
-void initialize_matrix(int matrix[MATRIX_SIZE][MATRIX_SIZE]) {
-    int value = 1;
-    for (int row = 0; row < MATRIX_SIZE; row++) {
-        for (int col = 0; col < MATRIX_SIZE; col++) {
-            matrix[row][col] = value++;
+// Valor del elemento (fila, col) de las matrices de entrada: valores
+// secuenciales (1, 2, 3, ...) que se repiten cada INIT_MODULUS elementos.
+// Al depender solo de la posición, cada proceso genera su propio bloque.
+static inline double init_value(long row, long col, int n) {
+    return (double)((row * n + col) % INIT_MODULUS + 1);
+}
+
+// Operaciones específicas de cada tipo de elemento
+typedef struct {
+    const char *name;
+    size_t size;
+    MPI_Datatype mpiType;
+    // C (m x n) += A (m x k) * B (k x n), en orden por filas
+    void (*gemm)(int m, int n, int k, const void *A, int lda, const void *B, int ldb, void *C, int ldc);
+    // Z = X + sign * Y para bloques rows x cols (Z puede ser X)
+    void (*add)(int rows, int cols, const void *X, int ldx, const void *Y, int ldy, void *Z, int ldz, int sign);
+    // Inicializar un bloque rows x cols que empieza en (row0, col0); los
+    // elementos fuera de la matriz n x n (relleno) quedan a cero
+    void (*fill)(void *block, int rows, int cols, int row0, int col0, int n);
+    // Leer un elemento como double
+    double (*get)(const void *block, size_t index);
+    // Imprimir un elemento
+    void (*print)(const void *block, size_t index);
+} ElementType;
+
+// Definir las operaciones de ElementType para un tipo de C
+#define DEFINE_ELEMENT_OPS(TYPE, SUFFIX, FORMAT)                                            \
+    static void multiply_##SUFFIX(int m, int n, int k, const void *A, int lda,              \
+                                  const void *B, int ldb, void *C, int ldc) {               \
+        gemm_##TYPE(m, n, k, A, lda, B, ldb, C, ldc);                                       \
+    }                                                                                       \
+    static void add_##SUFFIX(int rows, int cols, const void *X_, int ldx, const void *Y_,  \
+                             int ldy, void *Z_, int ldz, int sign) {                        \
+        const TYPE *X = X_;                                                                 \
+        const TYPE *Y = Y_;                                                                 \
+        TYPE *Z = Z_;                                                                       \
+        for (int i = 0; i < rows; i++) {                                                    \
+            for (int j = 0; j < cols; j++) {                                                \
+                Z[(size_t)i * ldz + j] = X[(size_t)i * ldx + j] + sign * Y[(size_t)i * ldy + j]; \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+    static void fill_##SUFFIX(void *block_, int rows, int cols, int row0, int col0, int n) { \
+        TYPE *block = block_;                                                               \
+        for (int i = 0; i < rows; i++) {                                                    \
+            for (int j = 0; j < cols; j++) {                                                \
+                int inside = (row0 + i < n) && (col0 + j < n);                              \
+                block[(size_t)i * cols + j] = inside ? (TYPE)init_value(row0 + i, col0 + j, n) : (TYPE)0; \
+            }                                                                               \
+        }                                                                                   \
+    }                                                                                       \
+    static double get_##SUFFIX(const void *block, size_t index) {                           \
+        return (double)((const TYPE *)block)[index];                                        \
+    }                                                                                       \
+    static void print_##SUFFIX(const void *block, size_t index) {                           \
+        printf(FORMAT, ((const TYPE *)block)[index]);                                       \
+    }
+
+DEFINE_ELEMENT_OPS(int, int, "%4d ")
+DEFINE_ELEMENT_OPS(double, double, "%8.1f ")
+
+// Seleccionar el tipo de elemento por nombre ("int" o "double")
+static int select_element_type(const char *name, ElementType *type) {
+    if (strcmp(name, "int") == 0) {
+        *type = (ElementType){ "int", sizeof(int), MPI_INT, multiply_int, add_int, fill_int, get_int, print_int };
+    } else if (strcmp(name, "double") == 0) {
+        *type = (ElementType){ "double", sizeof(double), MPI_DOUBLE, multiply_double, add_double, fill_double, get_double, print_double };
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Reparto en bloques de 'n' índices entre 'parts' partes: la parte 'p'
+// empieza en *start y tiene *count índices (las primeras n % parts tienen uno más)
+static void block_range(int n, int parts, int p, int *start, int *count) {
+    int base = n / parts;
+    int remaining = n % parts;
+    *count = base + (p < remaining ? 1 : 0);
+    *start = p * base + (p < remaining ? p : remaining);
+}
+
+// Parte a la que pertenece el índice 'i' en el reparto de block_range
+static int block_owner(int n, int parts, int i) {
+    int base = n / parts;
+    int remaining = n % parts;
+    int split = remaining * (base + 1);
+    return (i < split) ? i / (base + 1) : remaining + (i - split) / base;
+}
+
+// Fin (exclusivo) del bloque que contiene el índice 'i'
+static int block_end(int n, int parts, int i) {
+    int start, count;
+    block_range(n, parts, block_owner(n, parts, i), &start, &count);
+    return start + count;
+}
+
+// Malla 2D de procesos y bloque de las matrices asignado a este proceso
+typedef struct {
+    MPI_Comm comm;          // Comunicador cartesiano
+    MPI_Comm row_comm;      // Procesos de la misma fila de la malla
+    MPI_Comm col_comm;      // Procesos de la misma columna de la malla
+    int dims[2];
+    int my_row, my_col;     // Coordenadas en la malla
+    int row_start, my_rows; // Filas del bloque local
+    int col_start, my_cols; // Columnas del bloque local
+} Grid;
+
+// Métricas de comunicación y cómputo de un proceso
+typedef struct {
+    long bytes_sent;
+    long bytes_received;
+    double comp_time;
+    double comm_time;
+    double flops;           // Operaciones del producto clásico equivalente
+} Metrics;
+
+// Bloque de C en poder de un proceso: filas [row0, row0 + rows) y columnas
+// [col0, col0 + cols), con 'ld' elementos entre filas consecutivas
+typedef struct {
+    int row0, rows;
+    int col0, cols;
+    int ld;
+    void *data;
+} Block;
+
+// Paso de SUMMA: columnas [k, k + kb) de A y filas [k, k + kb) de B. Los
+// pasos se cortan en los límites de los bloques de A y de B para que cada
+// panel tenga un único propietario.
+typedef struct {
+    int k, kb;
+    int a_owner;    // Columna de la malla con A(:, k)
+    int b_owner;    // Fila de la malla con B(k, :)
+} SummaStep;
+
+static SummaStep summa_step(const Grid *grid, int n, int panel, int k) {
+    SummaStep step;
+    int k_end = k + panel;
+    int a_end = block_end(n, grid->dims[1], k);
+    int b_end = block_end(n, grid->dims[0], k);
+    if (a_end < k_end) k_end = a_end;
+    if (b_end < k_end) k_end = b_end;
+    step.k = k;
+    step.kb = k_end - k;
+    step.a_owner = block_owner(n, grid->dims[1], k);
+    step.b_owner = block_owner(n, grid->dims[0], k);
+    return step;
+}
+
+// Paneles de un paso de SUMMA en curso
+typedef struct {
+    void *a;                // Panel de A (my_rows x kb)
+    void *b_buffer;         // Búfer de recepción del panel de B
+    const void *b;          // Panel de B (kb x my_cols): b_buffer o el bloque local
+    MPI_Request requests[2];
+} SummaPanels;
+
+// Iniciar la difusión de los paneles de un paso: el propietario empaqueta
+// su parte de A y difunde B directamente desde su bloque local
+static void summa_post(const ElementType *type, const Grid *grid, const SummaStep *step,
+                       const void *local_A, const void *local_B, SummaPanels *panels, Metrics *metrics) {
+    size_t size = type->size;
+    int kb = step->kb;
+
+    if (grid->my_col == step->a_owner) {
+        for (int i = 0; i < grid->my_rows; i++) {
+            memcpy((char *)panels->a + (size_t)i * kb * size,
+                   (const char *)local_A + ((size_t)i * grid->my_cols + (step->k - grid->col_start)) * size,
+                   kb * size);
         }
     }
+    if (grid->my_row == step->b_owner) {
+        panels->b = (const char *)local_B + (size_t)(step->k - grid->row_start) * grid->my_cols * size;
+    } else {
+        panels->b = panels->b_buffer;
+    }
+
+    MPI_Ibcast(panels->a, grid->my_rows * kb, type->mpiType, step->a_owner, grid->row_comm, &panels->requests[0]);
+    MPI_Ibcast((void *)panels->b, kb * grid->my_cols, type->mpiType, step->b_owner, grid->col_comm, &panels->requests[1]);
+
+    long a_bytes = (long)grid->my_rows * kb * size;
+    long b_bytes = (long)kb * grid->my_cols * size;
+    if (grid->my_col == step->a_owner) metrics->bytes_sent += a_bytes * (grid->dims[1] - 1);
+    else metrics->bytes_received += a_bytes;
+    if (grid->my_row == step->b_owner) metrics->bytes_sent += b_bytes * (grid->dims[0] - 1);
+    else metrics->bytes_received += b_bytes;
 }
 
-// Función para imprimir una matriz
-void display_matrix(int matrix[MATRIX_SIZE][MATRIX_SIZE]) {
-    for (int row = 0; row < MATRIX_SIZE; row++) {
-        for (int col = 0; col < MATRIX_SIZE; col++) {
-            printf("%4d ", matrix[row][col]);
+// C = A * B con SUMMA: en cada paso se difunde un panel de columnas de A
+// por las filas de la malla y un panel de filas de B por las columnas, y
+// cada proceso acumula su producto. Con 'pipelined' la difusión del paso
+// siguiente se inicia antes de multiplicar el actual (doble búfer), y entre
+// bandas de filas de C se llama a MPI_Testall para que avance.
+static void summa_multiply(const ElementType *type, const Grid *grid, int n, int panel, int pipelined,
+                           const void *local_A, const void *local_B, void *local_C, Metrics *metrics) {
+    size_t size = type->size;
+    int my_rows = grid->my_rows, my_cols = grid->my_cols;
+    SummaPanels panels[2];
+    for (int slot = 0; slot < 2; slot++) {
+        panels[slot].a = malloc((size_t)my_rows * panel * size);
+        panels[slot].b_buffer = malloc((size_t)panel * my_cols * size);
+        if (panels[slot].a == NULL || panels[slot].b_buffer == NULL) {
+            fprintf(stderr, "No se pudo asignar memoria para los paneles\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
-        printf("\n");
+    }
+
+    double start_time = MPI_Wtime();
+    int slot = 0;
+    SummaStep step = summa_step(grid, n, panel, 0);
+    trace_begin("difusion");
+    summa_post(type, grid, &step, local_A, local_B, &panels[slot], metrics);
+    trace_end();
+    metrics->comm_time += MPI_Wtime() - start_time;
+
+    while (step.k < n) {
+        int next_k = step.k + step.kb;
+        int has_next = next_k < n;
+        SummaStep next;
+        if (has_next) next = summa_step(grid, n, panel, next_k);
+
+        start_time = MPI_Wtime();
+        trace_begin("difusion");
+        if (pipelined && has_next) {
+            summa_post(type, grid, &next, local_A, local_B, &panels[slot ^ 1], metrics);
+        }
+        MPI_Waitall(2, panels[slot].requests, MPI_STATUSES_IGNORE);
+        trace_end();
+        metrics->comm_time += MPI_Wtime() - start_time;
+
+        // Multiplicación de matrices parcial, por bandas de filas
+        start_time = MPI_Wtime();
+        trace_begin("gemm");
+        for (int i0 = 0; i0 < my_rows; i0 += BAND_ROWS) {
+            int rows = (my_rows - i0 < BAND_ROWS) ? my_rows - i0 : BAND_ROWS;
+            type->gemm(rows, my_cols, step.kb,
+                       (const char *)panels[slot].a + (size_t)i0 * step.kb * size, step.kb,
+                       panels[slot].b, my_cols,
+                       (char *)local_C + (size_t)i0 * my_cols * size, my_cols);
+            if (pipelined && has_next) {
+                int done;
+                MPI_Testall(2, panels[slot ^ 1].requests, &done, MPI_STATUSES_IGNORE);
+            }
+        }
+        trace_end();
+        metrics->comp_time += MPI_Wtime() - start_time;
+
+        if (!pipelined && has_next) {
+            start_time = MPI_Wtime();
+            trace_begin("difusion");
+            summa_post(type, grid, &next, local_A, local_B, &panels[slot ^ 1], metrics);
+            trace_end();
+            metrics->comm_time += MPI_Wtime() - start_time;
+        }
+
+        if (!has_next) break;
+        step = next;
+        slot ^= 1;
+    }
+
+    for (int s = 0; s < 2; s++) {
+        free(panels[s].a);
+        free(panels[s].b_buffer);
     }
 }
 
-int main(int argc, char *argv[]) {
-    int world_rank, world_size;
-    int A[MATRIX_SIZE][MATRIX_SIZE];
-    int B[MATRIX_SIZE][MATRIX_SIZE];
-    int result[MATRIX_SIZE][MATRIX_SIZE];
+// Número de niveles de Strassen locales y tamaño de cuadrante, múltiplo de
+// 2^niveles, para que la recursión siempre divida bloques de tamaño par
+static int strassen_quadrant_size(int n, int cutoff, int *levels) {
+    int h = (n + 1) / 2;
+    int depth = 0;
+    while (h > cutoff) {
+        h = (h + 1) / 2;
+        depth++;
+    }
+    if (levels) *levels = depth;
+    return h << depth;
+}
 
-    // Inicializar MPI
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+// C = A * B para matrices n x n con Strassen-Winograd (7 productos y 15
+// sumas por nivel) hasta bloques de tamaño 'cutoff', que se multiplican con
+// el núcleo clásico. En los primeros niveles los productos son tareas OpenMP.
+static void strassen_local(const ElementType *type, int n, const void *A, int lda, const void *B, int ldb,
+                           void *C, int ldc, int cutoff, int depth) {
+    size_t size = type->size;
+    if (n <= cutoff || n % 2 != 0) {
+        for (int i = 0; i < n; i++) {
+            memset((char *)C + (size_t)i * ldc * size, 0, n * size);
+        }
+        type->gemm(n, n, n, A, lda, B, ldb, C, ldc);
+        return;
+    }
 
-    // Variables para métricas
-    struct rusage usage_stats;
-    long bytes_sent = 0;
-    long bytes_received = 0;
-    double comp_start, comp_end, comp_time;
-    double comm_start, comm_end, comm_time;
+    int h = n / 2;
+#define QUAD(M, ld, r, c) ((char *)(M) + ((size_t)(r) * h * (ld) + (size_t)(c) * h) * size)
+    const void *A11 = QUAD(A, lda, 0, 0), *A12 = QUAD(A, lda, 0, 1);
+    const void *A21 = QUAD(A, lda, 1, 0), *A22 = QUAD(A, lda, 1, 1);
+    const void *B11 = QUAD(B, ldb, 0, 0), *B12 = QUAD(B, ldb, 0, 1);
+    const void *B21 = QUAD(B, ldb, 1, 0), *B22 = QUAD(B, ldb, 1, 1);
+    void *C11 = QUAD(C, ldc, 0, 0), *C12 = QUAD(C, ldc, 0, 1);
+    void *C21 = QUAD(C, ldc, 1, 0), *C22 = QUAD(C, ldc, 1, 1);
+#undef QUAD
 
-    // Inicializar matrices en el proceso maestro
-    if (world_rank == 0) {
-        initialize_matrix(A);
-        initialize_matrix(B);
+    // Sumas de A (S) y de B (T) y los siete productos (P), de h x h cada uno
+    size_t quad = (size_t)h * h * size;
+    char *work = malloc(15 * quad);
+    if (work == NULL) {
+        fprintf(stderr, "No se pudo asignar memoria para Strassen\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    void *S[4], *T[4], *P[7];
+    for (int i = 0; i < 4; i++) {
+        S[i] = work + i * quad;
+        T[i] = work + (4 + i) * quad;
+    }
+    for (int i = 0; i < 7; i++) P[i] = work + (8 + i) * quad;
 
-    // Compartir la matriz B con todos los procesos
-    MPI_Bcast(B, MATRIX_SIZE * MATRIX_SIZE, MPI_INT, 0, MPI_COMM_WORLD);
+    type->add(h, h, A21, lda, A22, lda, S[0], h, 1);    // S1 = A21 + A22
+    type->add(h, h, S[0], h, A11, lda, S[1], h, -1);    // S2 = S1 - A11
+    type->add(h, h, A11, lda, A21, lda, S[2], h, -1);   // S3 = A11 - A21
+    type->add(h, h, A12, lda, S[1], h, S[3], h, -1);    // S4 = A12 - S2
+    type->add(h, h, B12, ldb, B11, ldb, T[0], h, -1);   // T1 = B12 - B11
+    type->add(h, h, B22, ldb, T[0], h, T[1], h, -1);    // T2 = B22 - T1
+    type->add(h, h, B22, ldb, B12, ldb, T[2], h, -1);   // T3 = B22 - B12
+    type->add(h, h, T[1], h, B21, ldb, T[3], h, -1);    // T4 = T2 - B21
 
-    // Determinar el número de filas para cada proceso
-    int rows_per_proc = MATRIX_SIZE / world_size;
-    int remaining_rows = MATRIX_SIZE % world_size;
-    int my_rows = rows_per_proc + (world_rank < remaining_rows ? 1 : 0);
+    const void *left[7]  = { A11, A12, S[3], A22, S[0], S[1], S[2] };
+    const void *right[7] = { B11, B21, B22, T[3], T[0], T[1], T[2] };
+    int left_ld[7]  = { lda, lda, h, lda, h, h, h };
+    int right_ld[7] = { ldb, ldb, ldb, h, h, h, h };
 
-    // Calcular desplazamiento de filas
-    int row_offset = world_rank * rows_per_proc + (world_rank < remaining_rows ? world_rank : remaining_rows);
+    for (int i = 0; i < 7; i++) {
+#ifdef _OPENMP
+        #pragma omp task if(depth < STRASSEN_TASK_DEPTH) firstprivate(i)
+#endif
+        strassen_local(type, h, left[i], left_ld[i], right[i], right_ld[i], P[i], h, cutoff, depth + 1);
+    }
+#ifdef _OPENMP
+    #pragma omp taskwait
+#endif
 
-    // Buffer para las filas asignadas a este proceso
-    int local_A[my_rows][MATRIX_SIZE];
-    int local_result[my_rows][MATRIX_SIZE];
+    type->add(h, h, P[0], h, P[1], h, C11, ldc, 1);     // C11 = P1 + P2
+    type->add(h, h, P[0], h, P[5], h, P[0], h, 1);      // U2 = P1 + P6
+    type->add(h, h, P[0], h, P[6], h, P[5], h, 1);      // U3 = U2 + P7
+    type->add(h, h, P[5], h, P[3], h, C21, ldc, -1);    // C21 = U3 - P4
+    type->add(h, h, P[5], h, P[4], h, C22, ldc, 1);     // C22 = U3 + P5
+    type->add(h, h, P[0], h, P[4], h, C12, ldc, 1);     // U4 = U2 + P5
+    type->add(h, h, C12, ldc, P[2], h, C12, ldc, 1);    // C12 = U4 + P3
 
-    // Distribuir las filas de A a cada proceso
-    int *sendcounts = NULL;
-    int *displs = NULL;
-    if (world_rank == 0) {
-        sendcounts = malloc(world_size * sizeof(int));
-        displs = malloc(world_size * sizeof(int));
+    free(work);
+}
 
-        for (int i = 0; i < world_size; i++) {
-            int rows = rows_per_proc + (i < remaining_rows ? 1 : 0);
-            sendcounts[i] = rows * MATRIX_SIZE;
-            displs[i] = (i * rows_per_proc + (i < remaining_rows ? i : remaining_rows)) * MATRIX_SIZE;
+// Coeficientes de los siete productos del primer nivel de Strassen-Winograd
+// sobre los cuadrantes (11, 12, 21, 22): P = (sum a * A) * (sum b * B), y su
+// contribución c a cada cuadrante de C
+static const int strassen_a[7][4] = {
+    { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 1, 1, -1, -1 }, { 0, 0, 0, 1 },
+    { 0, 0, 1, 1 }, { -1, 0, 1, 1 }, { 1, 0, -1, 0 }
+};
+static const int strassen_b[7][4] = {
+    { 1, 0, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 }, { 1, -1, -1, 1 },
+    { -1, 1, 0, 0 }, { 1, -1, 0, 1 }, { 0, -1, 0, 1 }
+};
+static const int strassen_c[7][4] = {
+    { 1, 1, 1, 1 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, -1, 0 },
+    { 0, 1, 0, 1 }, { 0, 1, 1, 1 }, { 0, 0, 1, 1 }
+};
+
+// Generar la combinación lineal de cuadrantes (de tamaño h) indicada por 'coef'
+static void strassen_operand(const ElementType *type, int n, int h, const int coef[4], void *operand, void *scratch) {
+    int first = 1;
+    for (int q = 0; q < 4; q++) {
+        if (coef[q] == 0) continue;
+        int row0 = (q / 2) * h, col0 = (q % 2) * h;
+        if (first && coef[q] == 1) {
+            type->fill(operand, h, h, row0, col0, n);
+        } else {
+            if (first) memset(operand, 0, (size_t)h * h * type->size);
+            type->fill(scratch, h, h, row0, col0, n);
+            type->add(h, h, operand, h, scratch, h, operand, h, coef[q]);
+        }
+        first = 0;
+    }
+}
+
+// C = A * B con Strassen-Winograd. Los siete productos del primer nivel se
+// reparten entre los procesos (el producto p lo calcula el proceso p % P);
+// cada proceso genera los operandos que necesita a partir de los valores
+// iniciales, los multiplica con strassen_local y suma su contribución a
+// cada cuadrante de C, que se reduce en el proceso q % P. El resultado
+// queda en 'result': un cuadrante por ronda (vacío si no es propio).
+static void strassen_multiply(const ElementType *type, int n, int cutoff, Block result[4], Metrics *metrics) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int h = strassen_quadrant_size(n, cutoff, NULL);
+    size_t quad = (size_t)h * h * type->size;
+    char *contrib = calloc(4, quad);
+    char *work = malloc(4 * quad);
+    if (contrib == NULL || work == NULL) {
+        fprintf(stderr, "Proceso %d: no se pudo asignar memoria para Strassen\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    void *left = work, *right = work + quad, *product = work + 2 * quad, *scratch = work + 3 * quad;
+
+    double start_time = MPI_Wtime();
+    trace_begin("productos");
+    int products = 0;
+    for (int p = rank; p < 7; p += size) {
+        strassen_operand(type, n, h, strassen_a[p], left, scratch);
+        strassen_operand(type, n, h, strassen_b[p], right, scratch);
+
+#ifdef _OPENMP
+        #pragma omp parallel
+        #pragma omp single
+#endif
+        strassen_local(type, h, left, h, right, h, product, h, cutoff, 0);
+
+        for (int q = 0; q < 4; q++) {
+            if (strassen_c[p][q] != 0) {
+                void *cq = contrib + q * quad;
+                type->add(h, h, cq, h, product, h, cq, h, strassen_c[p][q]);
+            }
+        }
+        products++;
+    }
+    trace_end();
+    metrics->comp_time += MPI_Wtime() - start_time;
+    metrics->flops = 2.0 * n * (double)n * n * products / 7.0;
+
+    // Reducir las contribuciones de cada cuadrante en su propietario
+    start_time = MPI_Wtime();
+    trace_begin("reduccion");
+    for (int q = 0; q < 4; q++) {
+        int owner = q % size;
+        Block *block = &result[q];
+        memset(block, 0, sizeof(Block));
+        void *recv = NULL;
+        if (rank == owner) {
+            recv = malloc(quad);
+            block->row0 = (q / 2) * h;
+            block->col0 = (q % 2) * h;
+            // El relleno más allá de n no forma parte del resultado
+            block->rows = (n - block->row0 < h) ? n - block->row0 : h;
+            block->cols = (n - block->col0 < h) ? n - block->col0 : h;
+            block->ld = h;
+            block->data = recv;
         }
+        MPI_Reduce(contrib + q * quad, recv, h * h, type->mpiType, MPI_SUM, owner, MPI_COMM_WORLD);
+        if (rank == owner) metrics->bytes_received += (long)quad * (size - 1);
+        else metrics->bytes_sent += (long)quad;
     }
+    trace_end();
+    metrics->comm_time += MPI_Wtime() - start_time;
+
+    free(contrib);
+    free(work);
+}
+
+// Crear la malla 2D de procesos y calcular C = A * B con SUMMA. Cada
+// proceso genera su bloque de A y B; el bloque de C queda en 'result'.
+static void summa_run(const ElementType *type, int n, int panel, int pipelined, Block *result, Metrics *metrics) {
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    // Malla 2D de procesos: cada proceso tiene un bloque de A, B y C, de modo
+    // que la memoria por proceso es O(N^2 / P)
+    Grid grid;
+    int periods[2] = {0, 0};
+    grid.dims[0] = grid.dims[1] = 0;
+    MPI_Dims_create(world_size, 2, grid.dims);
+    MPI_Cart_create(MPI_COMM_WORLD, 2, grid.dims, periods, 1, &grid.comm);
+
+    int grid_rank, coords[2];
+    MPI_Comm_rank(grid.comm, &grid_rank);
+    MPI_Cart_coords(grid.comm, grid_rank, 2, coords);
+
+    // Comunicadores por fila (procesos con la misma fila de la malla) y por columna
+    int keep_cols[2] = {0, 1};
+    int keep_rows[2] = {1, 0};
+    MPI_Cart_sub(grid.comm, keep_cols, &grid.row_comm);
+    MPI_Cart_sub(grid.comm, keep_rows, &grid.col_comm);
 
-    MPI_Scatterv(&A[0][0], sendcounts, displs, MPI_INT,
-                 &local_A[0][0], my_rows * MATRIX_SIZE, MPI_INT,
-                 0, MPI_COMM_WORLD);
+    grid.my_row = coords[0];
+    grid.my_col = coords[1];
+    block_range(n, grid.dims[0], grid.my_row, &grid.row_start, &grid.my_rows);
+    block_range(n, grid.dims[1], grid.my_col, &grid.col_start, &grid.my_cols);
 
     if (world_rank == 0) {
-        free(sendcounts);
-        free(displs);
+        printf("Malla de %dx%d procesos, difusión %s\n", grid.dims[0], grid.dims[1],
+               pipelined ? "solapada" : "bloqueante");
     }
 
+    // Bloques locales de A, B y C
+    size_t block_elems = (size_t)grid.my_rows * grid.my_cols;
+    void *local_A = malloc(block_elems * type->size);
+    void *local_B = malloc(block_elems * type->size);
+    void *local_C = calloc(block_elems, type->size);
+    if (block_elems > 0 && (local_A == NULL || local_B == NULL || local_C == NULL)) {
+        fprintf(stderr, "Proceso %d: no se pudo asignar memoria para los bloques\n", world_rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Inicializar los bloques locales (A y B tienen los mismos valores)
+    trace_begin("generacion");
+    type->fill(local_A, grid.my_rows, grid.my_cols, grid.row_start, grid.col_start, n);
+    type->fill(local_B, grid.my_rows, grid.my_cols, grid.row_start, grid.col_start, n);
+    trace_end();
+
     // Sincronizar antes de iniciar el cómputo
     MPI_Barrier(MPI_COMM_WORLD);
 
-    // Iniciar medición de tiempo de cómputo
-    comp_start = MPI_Wtime();
+    summa_multiply(type, &grid, n, panel, pipelined, local_A, local_B, local_C, metrics);
+    metrics->flops = 2.0 * grid.my_rows * grid.my_cols * (double)n;
+
+    result->row0 = grid.row_start;
+    result->rows = grid.my_rows;
+    result->col0 = grid.col_start;
+    result->cols = grid.my_cols;
+    result->ld = grid.my_cols;
+    result->data = local_C;
+
+    free(local_A);
+    free(local_B);
+    MPI_Comm_free(&grid.row_comm);
+    MPI_Comm_free(&grid.col_comm);
+    MPI_Comm_free(&grid.comm);
+}
+
+// Verificar una muestra de elementos de un bloque de C contra el producto
+// calculado directamente a partir de los valores iniciales
+static long check_block(const ElementType *type, int n, const Block *block, double tolerance) {
+    long errors = 0;
+    size_t elems = (size_t)block->rows * block->cols;
+    for (int s = 0; s < CHECK_SAMPLES && elems > 0; s++) {
+        size_t index = (s == 0) ? 0 : ((size_t)s * 2654435761u) % elems;
+        int i = (int)(index / block->cols), j = (int)(index % block->cols);
+        double expected = 0;
+        for (int p = 0; p < n; p++) {
+            expected += init_value(block->row0 + i, p, n) * init_value(p, block->col0 + j, n);
+        }
+        double got = type->get(block->data, (size_t)i * block->ld + j);
+        if (fabs(got - expected) > tolerance * fabs(expected)) errors++;
+    }
+    return errors;
+}
+
+// Tipo de datos MPI que describe un bloque en memoria (filas con stride ld)
+static MPI_Datatype block_memory_type(const ElementType *type, const Block *block) {
+    MPI_Datatype memType;
+    MPI_Type_vector(block->rows, block->cols, block->ld, type->mpiType, &memType);
+    MPI_Type_commit(&memType);
+    return memType;
+}
+
+// Escribir un bloque de C en un archivo binario (n x n en orden por filas)
+// sin recolectarlo: cada proceso escribe su bloque con una vista de
+// subarreglo. Es colectiva; los procesos sin bloque escriben 0 elementos.
+static void write_block(MPI_File file, const ElementType *type, int n, const Block *block) {
+    int count = block->rows * block->cols;
+    MPI_Datatype fileType = type->mpiType, memType = type->mpiType;
+    if (count > 0) {
+        int sizes[2] = {n, n};
+        int subsizes[2] = {block->rows, block->cols};
+        int starts[2] = {block->row0, block->col0};
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, type->mpiType, &fileType);
+        MPI_Type_commit(&fileType);
+        memType = block_memory_type(type, block);
+    }
+    // La vista se fija en todos los procesos (es colectiva), incluso sin bloque
+    MPI_File_set_view(file, 0, type->mpiType, fileType, "native", MPI_INFO_NULL);
+    MPI_File_write_all(file, block->data, count > 0 ? 1 : 0, memType, MPI_STATUS_IGNORE);
 
-    // Multiplicación de matrices parcial
-    for (int i = 0; i < my_rows; i++) {
-        for (int j = 0; j < MATRIX_SIZE; j++) {
-            local_result[i][j] = 0;
-            for (int k = 0; k < MATRIX_SIZE; k++) {
-                local_result[i][j] += local_A[i][k] * B[k][j];
+    if (count > 0) {
+        MPI_Type_free(&fileType);
+        MPI_Type_free(&memType);
+    }
+}
+
+// Recolectar un bloque de cada proceso en la matriz completa del proceso 0
+static void gather_block(const ElementType *type, int n, const Block *block, void *matrix) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    int shape[4] = { block->row0, block->rows, block->col0, block->cols };
+    int *shapes = NULL, *recvcounts = NULL, *recvdispls = NULL;
+    void *blocks = NULL;
+    if (rank == 0) {
+        shapes = malloc(4 * size * sizeof(int));
+        recvcounts = malloc(size * sizeof(int));
+        recvdispls = malloc(size * sizeof(int));
+        blocks = malloc((size_t)n * n * type->size);
+        if (shapes == NULL || recvcounts == NULL || recvdispls == NULL || blocks == NULL) {
+            fprintf(stderr, "No se pudo asignar memoria para recolectar el resultado\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    MPI_Gather(shape, 4, MPI_INT, shapes, 4, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        for (int r = 0, offset = 0; r < size; r++) {
+            recvcounts[r] = shapes[4 * r + 1] * shapes[4 * r + 3];
+            recvdispls[r] = offset;
+            offset += recvcounts[r];
+        }
+    }
+
+    int count = block->rows * block->cols;
+    MPI_Datatype memType = (count > 0) ? block_memory_type(type, block) : type->mpiType;
+    MPI_Gatherv(block->data, count > 0 ? 1 : 0, memType, blocks, recvcounts, recvdispls, type->mpiType, 0, MPI_COMM_WORLD);
+    if (count > 0) MPI_Type_free(&memType);
+
+    if (rank == 0) {
+        // Colocar cada bloque en su posición dentro de la matriz completa
+        for (int r = 0; r < size; r++) {
+            int r_row0 = shapes[4 * r], r_rows = shapes[4 * r + 1];
+            int r_col0 = shapes[4 * r + 2], r_cols = shapes[4 * r + 3];
+            for (int i = 0; i < r_rows; i++) {
+                memcpy((char *)matrix + ((size_t)(r_row0 + i) * n + r_col0) * type->size,
+                       (char *)blocks + ((size_t)recvdispls[r] + (size_t)i * r_cols) * type->size,
+                       r_cols * type->size);
             }
         }
+        free(shapes);
+        free(recvcounts);
+        free(recvdispls);
+        free(blocks);
     }
+}
 
-    // Finalizar medición de tiempo de cómputo
-    comp_end = MPI_Wtime();
-    comp_time = comp_end - comp_start;
+// Función para imprimir una matriz n x n
+static void display_matrix(const ElementType *type, const void *matrix, int n) {
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++) {
+            type->print(matrix, (size_t)row * n + col);
+        }
+        printf("\n");
+    }
+}
 
-    // Iniciar medición de tiempo de comunicación
-    comm_start = MPI_Wtime();
+int main(int argc, char *argv[]) {
+    int world_rank, world_size;
 
-    // Recolectar los resultados parciales en el proceso maestro
-    int *recvcounts = NULL;
-    int *recvdispls = NULL;
+    // Inicializar MPI. Con -fopenmp, Strassen usa tareas OpenMP, pero solo
+    // el hilo maestro de cada proceso realiza llamadas MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    // Opciones: -n tamaño, -t int|double, -a algoritmo, -b ancho de panel,
+    // -r umbral de Strassen, -i repeticiones, -c verificar, -s difusión
+    // bloqueante, -d resultado distribuido, -o archivo de salida
+    int n = DEFAULT_MATRIX_SIZE;
+    int panel = DEFAULT_PANEL;
+    int cutoff = DEFAULT_STRASSEN_CUTOFF;
+    int strassen = 0;
+    int repetitions = 1;
+    int check = 0;
+    int pipelined = 1;
+    int distributed = 0;
+    const char *output_path = NULL;
+    ElementType type;
+    select_element_type("int", &type);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:a:b:r:i:csdo:")) != -1) {
+        int valid = 1;
+        switch (opt) {
+            case 'n': n = atoi(optarg); valid = (n > 0); break;
+            case 't': valid = (select_element_type(optarg, &type) == 0); break;
+            case 'a':
+                if (strcmp(optarg, "strassen") == 0) strassen = 1;
+                else if (strcmp(optarg, "summa") == 0) strassen = 0;
+                else valid = 0;
+                break;
+            case 'b': panel = atoi(optarg); valid = (panel > 0); break;
+            case 'r': cutoff = atoi(optarg); valid = (cutoff > 0); break;
+            case 'i': repetitions = atoi(optarg); valid = (repetitions > 0); break;
+            case 'c': check = 1; break;
+            case 's': pipelined = 0; break;
+            case 'd': distributed = 1; break;
+            case 'o': output_path = optarg; break;
+            default: valid = 0;
+        }
+        if (!valid) {
+            if (world_rank == 0) {
+                fprintf(stderr, "Uso: %s [-n tamaño] [-t int|double] [-a summa|strassen] [-b ancho_panel] "
+                                "[-r umbral_strassen] [-i repeticiones] [-c] [-s] [-d] [-o archivo]\n", argv[0]);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    const char *kernelName;
+    gemm_select(&kernelName);
     if (world_rank == 0) {
-        recvcounts = malloc(world_size * sizeof(int));
-        recvdispls = malloc(world_size * sizeof(int));
+        printf("Matrices de %dx%d (%s), algoritmo %s, núcleo GEMM: %s\n",
+               n, n, type.name, strassen ? "Strassen-Winograd" : "SUMMA", kernelName);
+#ifdef _OPENMP
+        if (provided < MPI_THREAD_FUNNELED) {
+            printf("Aviso: la biblioteca MPI no garantiza MPI_THREAD_FUNNELED\n");
+        }
+#endif
+    }
+
+    // Bloques de C en poder de este proceso: uno con SUMMA y un cuadrante
+    // por ronda con Strassen
+    Block result[4];
+    int rounds;
+    Metrics metrics = {0};
+    struct rusage usage_stats;
+    double tolerance;
 
-        for (int i = 0; i < world_size; i++) {
-            int rows = rows_per_proc + (i < remaining_rows ? 1 : 0);
-            recvcounts[i] = rows * MATRIX_SIZE;
-            recvdispls[i] = (i * rows_per_proc + (i < remaining_rows ? i : remaining_rows)) * MATRIX_SIZE;
+    if (strassen) {
+        int levels;
+        int h = strassen_quadrant_size(n, cutoff, &levels);
+        if (world_rank == 0) {
+            printf("Strassen: cuadrantes de %dx%d, %d niveles locales, umbral %d\n", h, h, levels, cutoff);
         }
     }
+    rounds = strassen ? 4 : 1;
+    tolerance = strassen ? STRASSEN_TOLERANCE : SUMMA_TOLERANCE;
 
-    MPI_Gatherv(&local_result[0][0], my_rows * MATRIX_SIZE, MPI_INT,
-                &result[0][0], recvcounts, recvdispls, MPI_INT,
-                0, MPI_COMM_WORLD);
+    // Con varias repeticiones se conservan el resultado de la última y las
+    // métricas de la más rápida en cada proceso
+    double *samples = malloc(repetitions * sizeof(double));
+    for (int rep = 0; rep < repetitions; rep++) {
+        Metrics run = {0};
+        if (rep > 0) {
+            for (int r = 0; r < rounds; r++) free(result[r].data);
+        }
+        if (strassen) {
+            MPI_Barrier(MPI_COMM_WORLD);
+            strassen_multiply(&type, n, cutoff, result, &run);
+        } else {
+            summa_run(&type, n, panel, pipelined, &result[0], &run);
+        }
+        samples[rep] = run.comp_time + run.comm_time;
+        if (rep == 0 || samples[rep] < metrics.comp_time + metrics.comm_time) {
+            metrics = run;
+        }
+    }
+    if (world_rank == 0 && repetitions > 1) {
+        printf("Repeticiones: %d (se muestran las métricas de la más rápida)\n", repetitions);
+    }
 
-    // Actualizar métricas de comunicación
-    bytes_sent += my_rows * MATRIX_SIZE * sizeof(int);
-    bytes_received += my_rows * MATRIX_SIZE * sizeof(int);
+    // Cada repetición dura lo que el proceso más lento
+    double *max_samples = malloc(repetitions * sizeof(double));
+    MPI_Reduce(samples, max_samples, repetitions, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (world_rank == 0) {
+        char variant[32], config[32];
+        snprintf(variant, sizeof(variant), "%s/%s", strassen ? "strassen" : "summa", type.name);
+        if (strassen) snprintf(config, sizeof(config), "umbral=%d", cutoff);
+        else snprintf(config, sizeof(config), "panel=%d %s", panel, pipelined ? "solapada" : "bloqueante");
+        BenchInfo info = { "matrices", variant, config, world_size, 1, n, 2.0 * n * n * (double)n, "GFLOP/s" };
+        bench_report(&info, max_samples, repetitions);
+    }
+    free(samples);
+    free(max_samples);
 
-    // Finalizar medición de tiempo de comunicación
-    comm_end = MPI_Wtime();
-    comm_time = comm_end - comm_start;
+    // Verificar una muestra de elementos de C
+    if (check) {
+        trace_begin("verificacion");
+        long errors = 0;
+        for (int r = 0; r < rounds; r++) {
+            errors += check_block(&type, n, &result[r], tolerance);
+        }
+        long total_errors;
+        MPI_Reduce(&errors, &total_errors, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (world_rank == 0) {
+            if (total_errors == 0) printf("Verificación: correcta\n");
+            else printf("Verificación: %ld elementos incorrectos\n", total_errors);
+        }
+        trace_end();
+    }
 
     // Obtener uso de recursos
     getrusage(RUSAGE_SELF, &usage_stats);
@@ -142,22 +806,71 @@ int main(int argc, char *argv[]) {
     // Mostrar métricas de cada proceso con mensajes diferentes
     printf(">>> Proceso [%d] Reporte de Métricas <<<\n", world_rank);
     printf("Memoria Máxima Usada: %ld KB\n", usage_stats.ru_maxrss);
-    printf("Tiempo de Cómputo: %.6f segundos\n", comp_time);
-    printf("Tiempo de Comunicación: %.6f segundos\n", comm_time);
-    printf("Datos Enviados: %ld bytes\n", bytes_sent);
-    printf("Datos Recibidos: %ld bytes\n", bytes_received);
+    printf("Tiempo de Cómputo: %.6f segundos\n", metrics.comp_time);
+    printf("Tiempo de Comunicación: %.6f segundos\n", metrics.comm_time);
+    printf("Rendimiento: %.3f GFLOP/s\n", metrics.comp_time > 0 ? metrics.flops / metrics.comp_time * 1e-9 : 0.0);
+    printf("Datos Enviados: %ld bytes\n", metrics.bytes_sent);
+    printf("Datos Recibidos: %ld bytes\n", metrics.bytes_received);
     printf("-------------------------------\n\n");
 
-    // El proceso maestro muestra el resultado final
-    if (world_rank == 0) {
-        printf("===== Resultado de la Multiplicación de Matrices =====\n");
-        display_matrix(result);
+    // Guardar C en un archivo: cada proceso escribe sus bloques directamente
+    if (output_path != NULL) {
+        trace_begin("escritura");
+        MPI_File file;
+        if (MPI_File_open(MPI_COMM_WORLD, output_path, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                          MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+            fprintf(stderr, "No se pudo crear el archivo %s\n", output_path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_File_set_size(file, 0);
+        for (int r = 0; r < rounds; r++) {
+            write_block(file, &type, n, &result[r]);
+        }
+        MPI_File_close(&file);
+        trace_end();
+    }
+
+    // Recolectar los bloques de C en el proceso maestro, salvo que se pida
+    // mantener el resultado distribuido; solo se muestra si es pequeño.
+    // MPI_Gatherv cuenta elementos con int, lo que limita N a 46340
+    if (!distributed && (long)n * n > INT_MAX) {
+        if (world_rank == 0) {
+            printf("Resultado demasiado grande para recolectarlo en el proceso 0; use -d u -o\n");
+        }
+    } else if (!distributed) {
+        trace_begin("recoleccion");
+        void *matrix = NULL;
+        if (world_rank == 0) {
+            matrix = malloc((size_t)n * n * type.size);
+            if (matrix == NULL) {
+                fprintf(stderr, "No se pudo asignar memoria para recolectar el resultado\n");
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        }
+        for (int r = 0; r < rounds; r++) {
+            gather_block(&type, n, &result[r], matrix);
+        }
+        trace_end();
+        if (world_rank == 0) {
+            if (n <= DISPLAY_LIMIT) {
+                printf("===== Resultado de la Multiplicación de Matrices =====\n");
+                display_matrix(&type, matrix, n);
+            }
+            free(matrix);
+        }
+    }
 
-        // Esperar a que el usuario presione Enter antes de finalizar
+    // Esperar a que el usuario presione Enter solo en ejecuciones
+    // interactivas, para no bloquear trabajos por lotes
+    if (world_rank == 0 && argc == 1 && isatty(STDIN_FILENO)) {
         printf("\nPresione Enter para finalizar...");
         getchar();
     }
 
+    for (int r = 0; r < rounds; r++) {
+        free(result[r].data);
+    }
+
     // Finalizar MPI
     MPI_Finalize();
     return 0;
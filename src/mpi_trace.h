@@ -0,0 +1,544 @@
+// mpi_trace.h
+// Instrumentación ligera de los programas MPI. Al compilar con -DMPI_TRACE
+// se interceptan las llamadas MPI que usan los programas (interfaz PMPI) y
+// se registran, por fase y por llamada, el número de llamadas, el tiempo y
+// los bytes de datos que salen y entran en el proceso (mensajes, colectivas
+// y E/S con MPI-IO). Las fases se marcan con trace_begin/trace_end. Al
+// llamar a MPI_Finalize el proceso 0 muestra la tabla agregada de todos los
+// procesos (mínimo, máximo, media y desequilibrio) y, si se define
+// MPI_TRACE_FILE, escribe una línea de tiempo en formato Chrome Trace
+// (chrome://tracing o https://ui.perfetto.dev).
+//
+// Sin -DMPI_TRACE las funciones de fase no hacen nada. Este archivo debe
+// incluirse en un único archivo fuente de cada programa.
+#ifndef MPI_TRACE_H
+#define MPI_TRACE_H
+
+#include <mpi.h>
+
+#ifndef MPI_TRACE
+
+static inline void trace_begin(const char *phase) { (void)phase; }
+static inline void trace_end(void) {}
+
+#else
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAX_PHASES 32
+#define TRACE_MAX_DEPTH 8
+#define TRACE_NAME 32
+#define TRACE_MAX_EVENTS (1 << 16)
+
+// Llamadas interceptadas; TRACE_PHASE es el tiempo total de la fase
+enum {
+    TRACE_PHASE, TRACE_SEND, TRACE_RECV, TRACE_ISEND, TRACE_IRECV, TRACE_WAIT, TRACE_WAITALL,
+    TRACE_TESTALL, TRACE_BARRIER, TRACE_BCAST, TRACE_IBCAST, TRACE_REDUCE, TRACE_ALLREDUCE,
+    TRACE_GATHER, TRACE_GATHERV, TRACE_ALLTOALL, TRACE_ALLTOALLV, TRACE_REDUCE_SCATTER, TRACE_FILE_READ_AT, TRACE_FILE_WRITE_AT,
+    TRACE_FILE_WRITE_ALL, TRACE_FILE_IWRITE_AT_ALL, TRACE_FETCH_AND_OP, TRACE_CALLS
+};
+
+static const char *trace_call_names[TRACE_CALLS] = {
+    "(fase)", "MPI_Send", "MPI_Recv", "MPI_Isend", "MPI_Irecv", "MPI_Wait", "MPI_Waitall",
+    "MPI_Testall", "MPI_Barrier", "MPI_Bcast", "MPI_Ibcast", "MPI_Reduce", "MPI_Allreduce",
+    "MPI_Gather", "MPI_Gatherv", "MPI_Alltoall", "MPI_Alltoallv", "MPI_Reduce_scatter", "MPI_File_read_at", "MPI_File_write_at",
+    "MPI_File_write_all", "MPI_File_iwrite_at_all", "MPI_Fetch_and_op"
+};
+
+typedef struct {
+    long calls;
+    double time;
+    double bytes_out;   // datos enviados o escritos
+    double bytes_in;    // datos recibidos o leídos
+} TraceStats;
+
+// Registro serializado para agregar entre procesos
+typedef struct {
+    char phase[TRACE_NAME];
+    int call;
+    TraceStats stats;
+} TraceRecord;
+
+// Intervalo de la línea de tiempo (fase o llamada MPI)
+typedef struct {
+    char name[TRACE_NAME];
+    int isPhase;
+    double start, duration;
+} TraceEvent;
+
+static struct {
+    int active;
+    double origin;
+    int phases;
+    const char *phaseNames[TRACE_MAX_PHASES];
+    TraceStats stats[TRACE_MAX_PHASES][TRACE_CALLS];
+    int stack[TRACE_MAX_DEPTH];
+    double stackStart[TRACE_MAX_DEPTH];
+    int depth;
+    TraceEvent *events;
+    int eventCount;
+    long droppedEvents;
+} trace_state;
+
+static void trace_event(const char *name, int isPhase, double start, double duration) {
+    if (trace_state.events == NULL) return;
+    if (trace_state.eventCount == TRACE_MAX_EVENTS) {
+        trace_state.droppedEvents++;
+        return;
+    }
+    TraceEvent *e = &trace_state.events[trace_state.eventCount++];
+    snprintf(e->name, TRACE_NAME, "%s", name);
+    e->isPhase = isPhase;
+    e->start = start - trace_state.origin;
+    e->duration = duration;
+}
+
+// Índice de una fase por nombre; la fase 0 agrupa lo que no está en ninguna
+static int trace_phase_index(const char *phase) {
+    for (int i = 0; i < trace_state.phases; i++) {
+        if (strcmp(trace_state.phaseNames[i], phase) == 0) return i;
+    }
+    if (trace_state.phases == TRACE_MAX_PHASES) return 0;
+    trace_state.phaseNames[trace_state.phases] = phase;
+    return trace_state.phases++;
+}
+
+static void trace_start(void) {
+    memset(&trace_state, 0, sizeof(trace_state));
+    trace_phase_index("(sin fase)");
+    if (getenv("MPI_TRACE_FILE") != NULL) {
+        trace_state.events = malloc(TRACE_MAX_EVENTS * sizeof(TraceEvent));
+    }
+    // Origen común aproximado de la línea de tiempo
+    PMPI_Barrier(MPI_COMM_WORLD);
+    trace_state.origin = PMPI_Wtime();
+    trace_state.active = 1;
+}
+
+// Marcar el inicio y el final de una fase. Las fases pueden anidarse; las
+// llamadas MPI se atribuyen a la fase más interna. 'phase' debe ser una
+// cadena constante.
+static inline void trace_begin(const char *phase) {
+    if (!trace_state.active || trace_state.depth == TRACE_MAX_DEPTH) return;
+    trace_state.stack[trace_state.depth] = trace_phase_index(phase);
+    trace_state.stackStart[trace_state.depth] = PMPI_Wtime();
+    trace_state.depth++;
+}
+
+static inline void trace_end(void) {
+    if (!trace_state.active || trace_state.depth == 0) return;
+    trace_state.depth--;
+    int phase = trace_state.stack[trace_state.depth];
+    double start = trace_state.stackStart[trace_state.depth];
+    double duration = PMPI_Wtime() - start;
+    TraceStats *s = &trace_state.stats[phase][TRACE_PHASE];
+    s->calls++;
+    s->time += duration;
+    trace_event(trace_state.phaseNames[phase], 1, start, duration);
+}
+
+// Registrar una llamada que empezó en 'start'
+static void trace_record(int call, double start, double bytesOut, double bytesIn) {
+    if (!trace_state.active) return;
+    double duration = PMPI_Wtime() - start;
+    int phase = trace_state.depth ? trace_state.stack[trace_state.depth - 1] : 0;
+    TraceStats *s = &trace_state.stats[phase][call];
+    s->calls++;
+    s->time += duration;
+    s->bytes_out += bytesOut;
+    s->bytes_in += bytesIn;
+    trace_event(trace_call_names[call], 0, start, duration);
+}
+
+static double trace_bytes(int count, MPI_Datatype type) {
+    int size;
+    PMPI_Type_size(type, &size);
+    return (double)count * size;
+}
+
+// Recolectar en el proceso 0 un bloque de bytes de cada proceso
+static char *trace_gather(const void *data, int bytes, int rank, int size, int **counts, int **offsets) {
+    *counts = malloc(size * sizeof(int));
+    *offsets = malloc(size * sizeof(int));
+    PMPI_Gather(&bytes, 1, MPI_INT, *counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    char *all = NULL;
+    if (rank == 0) {
+        int total = 0;
+        for (int i = 0; i < size; i++) {
+            (*offsets)[i] = total;
+            total += (*counts)[i];
+        }
+        all = malloc(total + 1);
+    }
+    PMPI_Gatherv(data, bytes, MPI_BYTE, all, *counts, *offsets, MPI_BYTE, 0, MPI_COMM_WORLD);
+    return all;
+}
+
+// Escribir la línea de tiempo de todos los procesos (un "pid" por proceso)
+static void trace_write_timeline(int rank, int size) {
+    int *counts, *offsets;
+    char *all = trace_gather(trace_state.events, trace_state.eventCount * (int)sizeof(TraceEvent),
+                             rank, size, &counts, &offsets);
+    long dropped;
+    PMPI_Reduce(&trace_state.droppedEvents, &dropped, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        const char *path = getenv("MPI_TRACE_FILE");
+        FILE *out = fopen(path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "No se pudo crear %s\n", path);
+        } else {
+            fprintf(out, "{\"traceEvents\": [\n");
+            int first = 1;
+            for (int r = 0; r < size; r++) {
+                const TraceEvent *e = (const TraceEvent *)(all + offsets[r]);
+                for (int i = 0; i < counts[r] / (int)sizeof(TraceEvent); i++) {
+                    fprintf(out, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                                 "\"dur\": %.3f, \"pid\": %d, \"tid\": %d}",
+                            first ? "" : ",\n", e[i].name, e[i].isPhase ? "fase" : "mpi",
+                            e[i].start * 1e6, e[i].duration * 1e6, r, e[i].isPhase ? 0 : 1);
+                    first = 0;
+                }
+            }
+            fprintf(out, "\n], \"displayTimeUnit\": \"ms\"}\n");
+            fclose(out);
+            printf("Línea de tiempo en %s", path);
+            if (dropped > 0) printf(" (%ld eventos descartados)", dropped);
+            printf("\n");
+        }
+    }
+    free(all);
+    free(counts);
+    free(offsets);
+}
+
+// Agregar las estadísticas de todos los procesos y mostrarlas en el proceso 0
+static void trace_report(void) {
+    int rank, size;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &size);
+    while (trace_state.depth > 0) trace_end();
+    trace_state.active = 0;
+
+    // Cada proceso serializa sus entradas no vacías
+    int count = 0;
+    TraceRecord *records = malloc((size_t)TRACE_MAX_PHASES * TRACE_CALLS * sizeof(TraceRecord));
+    for (int p = 0; p < trace_state.phases; p++) {
+        for (int c = 0; c < TRACE_CALLS; c++) {
+            if (trace_state.stats[p][c].calls == 0) continue;
+            snprintf(records[count].phase, TRACE_NAME, "%s", trace_state.phaseNames[p]);
+            records[count].call = c;
+            records[count].stats = trace_state.stats[p][c];
+            count++;
+        }
+    }
+
+    int *counts, *offsets;
+    char *all = trace_gather(records, count * (int)sizeof(TraceRecord), rank, size, &counts, &offsets);
+
+    if (rank == 0) {
+        // Combinar por (fase, llamada) en el orden de aparición; los procesos
+        // sin la entrada cuentan con tiempo cero
+        int total = 0;
+        for (int r = 0; r < size; r++) total += counts[r] / (int)sizeof(TraceRecord);
+        TraceRecord *merged = malloc((total + 1) * sizeof(TraceRecord));
+        double *minTime = malloc((total + 1) * sizeof(double));
+        double *maxTime = malloc((total + 1) * sizeof(double));
+        int *present = malloc((total + 1) * sizeof(int));
+        int unique = 0;
+
+        for (int r = 0; r < size; r++) {
+            const TraceRecord *rec = (const TraceRecord *)(all + offsets[r]);
+            for (int i = 0; i < counts[r] / (int)sizeof(TraceRecord); i++) {
+                int k = 0;
+                while (k < unique && (merged[k].call != rec[i].call || strcmp(merged[k].phase, rec[i].phase) != 0)) k++;
+                if (k == unique) {
+                    merged[k] = rec[i];
+                    minTime[k] = maxTime[k] = rec[i].stats.time;
+                    present[k] = 1;
+                    unique++;
+                    continue;
+                }
+                merged[k].stats.calls += rec[i].stats.calls;
+                merged[k].stats.time += rec[i].stats.time;
+                merged[k].stats.bytes_out += rec[i].stats.bytes_out;
+                merged[k].stats.bytes_in += rec[i].stats.bytes_in;
+                if (rec[i].stats.time < minTime[k]) minTime[k] = rec[i].stats.time;
+                if (rec[i].stats.time > maxTime[k]) maxTime[k] = rec[i].stats.time;
+                present[k]++;
+            }
+        }
+
+        printf("\n===== Traza MPI: %d procesos (tiempos en segundos, bytes totales) =====\n", size);
+        printf("%-16s %-24s %10s %12s %12s %12s %8s %14s %14s\n", "Fase", "Llamada", "Llamadas",
+               "Mínimo", "Máximo", "Medio", "Deseq.", "Bytes salida", "Bytes entrada");
+        // Cada fase en el orden en que apareció, con sus llamadas debajo
+        for (int p = 0; p < unique; p++) {
+            int firstOfPhase = 1;
+            for (int q = 0; q < p && firstOfPhase; q++) {
+                if (strcmp(merged[q].phase, merged[p].phase) == 0) firstOfPhase = 0;
+            }
+            if (!firstOfPhase) continue;
+            for (int call = 0; call < TRACE_CALLS; call++) {
+                for (int k = p; k < unique; k++) {
+                    if (merged[k].call != call || strcmp(merged[k].phase, merged[p].phase) != 0) continue;
+                    double mean = merged[k].stats.time / size;
+                    double minimum = (present[k] < size) ? 0.0 : minTime[k];
+                    // Desequilibrio: cuánto supera el proceso más lento a la media
+                    double imbalance = (mean > 0) ? maxTime[k] / mean - 1.0 : 0.0;
+                    printf("%-16s %-24s %10ld %12.6f %12.6f %12.6f %7.1f%% %14.0f %14.0f\n",
+                           merged[k].phase, trace_call_names[call], merged[k].stats.calls, minimum,
+                           maxTime[k], mean, imbalance * 100.0, merged[k].stats.bytes_out, merged[k].stats.bytes_in);
+                }
+            }
+        }
+        printf("-------------------------------\n\n");
+
+        free(merged);
+        free(minTime);
+        free(maxTime);
+        free(present);
+    }
+    free(all);
+    free(counts);
+    free(offsets);
+    free(records);
+
+    if (trace_state.events != NULL) {
+        trace_write_timeline(rank, size);
+        free(trace_state.events);
+        trace_state.events = NULL;
+    }
+}
+
+// Envolturas PMPI: miden la llamada real y registran tiempo y bytes
+
+int MPI_Init(int *argc, char ***argv) {
+    int result = PMPI_Init(argc, argv);
+    trace_start();
+    return result;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided) {
+    int result = PMPI_Init_thread(argc, argv, required, provided);
+    trace_start();
+    return result;
+}
+
+int MPI_Finalize(void) {
+    trace_report();
+    return PMPI_Finalize();
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Send(buf, count, type, dest, tag, comm);
+    trace_record(TRACE_SEND, start, trace_bytes(count, type), 0);
+    return result;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+    MPI_Status local;
+    if (status == MPI_STATUS_IGNORE) status = &local;
+    double start = PMPI_Wtime();
+    int result = PMPI_Recv(buf, count, type, source, tag, comm, status);
+    int received = 0;
+    PMPI_Get_count(status, type, &received);
+    trace_record(TRACE_RECV, start, 0, trace_bytes(received == MPI_UNDEFINED ? count : received, type));
+    return result;
+}
+
+// Los bytes de las operaciones no bloqueantes se cuentan al iniciarlas; el
+// tiempo de espera queda en MPI_Wait/MPI_Waitall
+int MPI_Isend(const void *buf, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm, MPI_Request *request) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Isend(buf, count, type, dest, tag, comm, request);
+    trace_record(TRACE_ISEND, start, dest == MPI_PROC_NULL ? 0 : trace_bytes(count, type), 0);
+    return result;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Request *request) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Irecv(buf, count, type, source, tag, comm, request);
+    trace_record(TRACE_IRECV, start, 0, source == MPI_PROC_NULL ? 0 : trace_bytes(count, type));
+    return result;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Wait(request, status);
+    trace_record(TRACE_WAIT, start, 0, 0);
+    return result;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Waitall(count, requests, statuses);
+    trace_record(TRACE_WAITALL, start, 0, 0);
+    return result;
+}
+
+int MPI_Testall(int count, MPI_Request requests[], int *flag, MPI_Status statuses[]) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Testall(count, requests, flag, statuses);
+    trace_record(TRACE_TESTALL, start, 0, 0);
+    return result;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Barrier(comm);
+    trace_record(TRACE_BARRIER, start, 0, 0);
+    return result;
+}
+
+// En las colectivas se cuentan los datos que aporta o recibe cada proceso
+static void trace_root_bytes(MPI_Comm comm, int root, double bytes, double *out, double *in) {
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    *out = (rank == root) ? bytes : 0;
+    *in = (rank == root) ? 0 : bytes;
+}
+
+int MPI_Bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+    double start = PMPI_Wtime(), out, in;
+    int result = PMPI_Bcast(buf, count, type, root, comm);
+    trace_root_bytes(comm, root, trace_bytes(count, type), &out, &in);
+    trace_record(TRACE_BCAST, start, out, in);
+    return result;
+}
+
+int MPI_Ibcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm, MPI_Request *request) {
+    double start = PMPI_Wtime(), out, in;
+    int result = PMPI_Ibcast(buf, count, type, root, comm, request);
+    trace_root_bytes(comm, root, trace_bytes(count, type), &out, &in);
+    trace_record(TRACE_IBCAST, start, out, in);
+    return result;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    double bytes = trace_bytes(count, type);
+    trace_record(TRACE_REDUCE, start, bytes, rank == root ? bytes : 0);
+    return result;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    double bytes = trace_bytes(count, type);
+    trace_record(TRACE_ALLREDUCE, start, bytes, bytes);
+    return result;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    int rank, size;
+    PMPI_Comm_rank(comm, &rank);
+    PMPI_Comm_size(comm, &size);
+    trace_record(TRACE_GATHER, start, trace_bytes(sendcount, sendtype),
+                 rank == root ? trace_bytes(recvcount, recvtype) * size : 0);
+    return result;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    int rank, size;
+    PMPI_Comm_rank(comm, &rank);
+    PMPI_Comm_size(comm, &size);
+    double in = 0;
+    if (rank == root) {
+        for (int i = 0; i < size; i++) in += trace_bytes(recvcounts[i], recvtype);
+    }
+    trace_record(TRACE_GATHERV, start, trace_bytes(sendcount, sendtype), in);
+    return result;
+}
+
+int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    int size;
+    PMPI_Comm_size(comm, &size);
+    trace_record(TRACE_ALLTOALL, start, trace_bytes(sendcount, sendtype) * size, trace_bytes(recvcount, recvtype) * size);
+    return result;
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+                  void *recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    int size;
+    PMPI_Comm_size(comm, &size);
+    double out = 0, in = 0;
+    for (int i = 0; i < size; i++) {
+        out += trace_bytes(sendcounts[i], sendtype);
+        in += trace_bytes(recvcounts[i], recvtype);
+    }
+    trace_record(TRACE_ALLTOALLV, start, out, in);
+    return result;
+}
+
+int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[], MPI_Datatype type, MPI_Op op,
+                       MPI_Comm comm) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, type, op, comm);
+    int rank, size;
+    PMPI_Comm_rank(comm, &rank);
+    PMPI_Comm_size(comm, &size);
+    double out = 0;
+    for (int i = 0; i < size; i++) out += trace_bytes(recvcounts[i], type);
+    trace_record(TRACE_REDUCE_SCATTER, start, out, trace_bytes(recvcounts[rank], type));
+    return result;
+}
+
+int MPI_File_read_at(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype type, MPI_Status *status) {
+    double start = PMPI_Wtime();
+    int result = PMPI_File_read_at(fh, offset, buf, count, type, status);
+    trace_record(TRACE_FILE_READ_AT, start, 0, trace_bytes(count, type));
+    return result;
+}
+
+int MPI_File_write_at(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype type, MPI_Status *status) {
+    double start = PMPI_Wtime();
+    int result = PMPI_File_write_at(fh, offset, buf, count, type, status);
+    trace_record(TRACE_FILE_WRITE_AT, start, trace_bytes(count, type), 0);
+    return result;
+}
+
+int MPI_File_write_all(MPI_File fh, const void *buf, int count, MPI_Datatype type, MPI_Status *status) {
+    double start = PMPI_Wtime();
+    int result = PMPI_File_write_all(fh, buf, count, type, status);
+    trace_record(TRACE_FILE_WRITE_ALL, start, trace_bytes(count, type), 0);
+    return result;
+}
+
+int MPI_File_iwrite_at_all(MPI_File fh, MPI_Offset offset, const void *buf, int count, MPI_Datatype type,
+                           MPI_Request *request) {
+    double start = PMPI_Wtime();
+    int result = PMPI_File_iwrite_at_all(fh, offset, buf, count, type, request);
+    trace_record(TRACE_FILE_IWRITE_AT_ALL, start, trace_bytes(count, type), 0);
+    return result;
+}
+
+int MPI_Fetch_and_op(const void *origin, void *result_addr, MPI_Datatype type, int target_rank,
+                     MPI_Aint target_disp, MPI_Op op, MPI_Win win) {
+    double start = PMPI_Wtime();
+    int result = PMPI_Fetch_and_op(origin, result_addr, type, target_rank, target_disp, op, win);
+    double bytes = trace_bytes(1, type);
+    trace_record(TRACE_FETCH_AND_OP, start, bytes, bytes);
+    return result;
+}
+
+#endif // MPI_TRACE
+
+#endif // MPI_TRACE_H
@@ -0,0 +1,449 @@
+// pipeline.h
+// Cadenas de filtros fusionadas fila a fila sobre el motor de stencil.h.
+// Cada etapa entrega sus filas bajo demanda a la siguiente y solo guarda la
+// ventana de filas que necesita, de modo que los resultados intermedios
+// (gris, suavizado, gradiente) nunca ocupan una imagen completa ni pasan por
+// disco. La cadena se describe con etapas separadas por '+':
+//   filtro                     cualquier descripción de stencil_parse
+//   nms                        supresión de no máximos; sigue a un gradiente
+//                              (sobel, scharr, prewitt), que entonces entrega
+//                              la magnitud sin saturar y su dirección
+//   histeresis[:bajo:alto]     umbral doble y seguimiento de bordes; sigue a
+//                              nms y cierra la cadena
+//   canny[:radio[:bajo:alto]]  gauss:radio+sobel+nms+histeresis:bajo:alto
+//                              (radio 0: sin suavizado)
+// La histéresis no es local: la cadena marca en la salida los bordes fuertes
+// (255) y débiles (PIPELINE_WEAK), pipeline_grow propaga los fuertes a los
+// débiles conectados y pipeline_finish descarta los que quedan.
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "stencil.h"
+
+#define PIPELINE_MAX_STAGES 8
+
+// Marca de borde débil pendiente de la histéresis
+#define PIPELINE_WEAK 128
+
+// Umbrales por defecto de la histéresis sobre la magnitud del gradiente
+#define PIPELINE_LOW 40.0f
+#define PIPELINE_HIGH 100.0f
+
+// Tipo de etapa
+enum { PIPELINE_STENCIL, PIPELINE_NMS };
+
+typedef struct {
+    int type;
+    int radius;
+    int gradient;        // entrega magnitud y dirección a la supresión
+    Stencil stencil;
+} PipelineStage;
+
+typedef struct {
+    char name[64];       // nombre apto para archivos y reportes
+    int stages;
+    int radius;          // filas vecinas de la entrada que necesita cada fila
+    int hysteresis;
+    float low, high;
+    PipelineStage stage[PIPELINE_MAX_STAGES];
+} Pipeline;
+
+static PipelineStage *pipeline_add(Pipeline *p, int type, int radius) {
+    if (p->stages == PIPELINE_MAX_STAGES) return NULL;
+    PipelineStage *stage = &p->stage[p->stages++];
+    memset(stage, 0, sizeof(PipelineStage));
+    stage->type = type;
+    stage->radius = radius;
+    p->radius += radius;
+    return stage;
+}
+
+static int pipeline_add_stencil(Pipeline *p, const char *spec) {
+    PipelineStage *stage = pipeline_add(p, PIPELINE_STENCIL, 0);
+    if (stage == NULL || stencil_parse(spec, &stage->stencil) != 0) return -1;
+    stage->radius = stage->stencil.radius;
+    p->radius += stage->radius;
+    return 0;
+}
+
+// La supresión necesita que la etapa anterior sea un gradiente
+static int pipeline_add_nms(Pipeline *p) {
+    PipelineStage *last = p->stages ? &p->stage[p->stages - 1] : NULL;
+    if (last == NULL || last->type != PIPELINE_STENCIL || last->gradient ||
+        last->stencil.output != STENCIL_MAGNITUDE) return -1;
+    last->gradient = 1;
+    return pipeline_add(p, PIPELINE_NMS, 1) ? 0 : -1;
+}
+
+static int pipeline_set_hysteresis(Pipeline *p, float low, float high) {
+    if (p->stages == 0 || p->stage[p->stages - 1].type != PIPELINE_NMS) return -1;
+    if (low < 0.0f || high < low) return -1;
+    p->hysteresis = 1;
+    p->low = low;
+    p->high = high;
+    return 0;
+}
+
+// Construir una cadena a partir de su descripción. Devuelve 0 si es válida.
+static int pipeline_parse(const char *spec, Pipeline *p) {
+    char text[256];
+    snprintf(text, sizeof(text), "%s", spec);
+    memset(p, 0, sizeof(Pipeline));
+
+    char *saved;
+    for (char *token = strtok_r(text, "+", &saved); token != NULL; token = strtok_r(NULL, "+", &saved)) {
+        if (p->hysteresis) return -1;
+
+        char label[64];
+        float low = PIPELINE_LOW, high = PIPELINE_HIGH;
+        if (strncmp(token, "canny", 5) == 0 && (token[5] == '\0' || token[5] == ':')) {
+            int radius = 2, fields = 0;
+            if (token[5] == ':') {
+                fields = sscanf(token + 6, "%d:%f:%f", &radius, &low, &high);
+                if (fields != 1 && fields != 3) return -1;
+            }
+            if (radius < 0 || radius > STENCIL_MAX_RADIUS) return -1;
+            if (radius > 0) {
+                char gauss[16];
+                snprintf(gauss, sizeof(gauss), "gauss:%d", radius);
+                if (pipeline_add_stencil(p, gauss) != 0) return -1;
+            }
+            if (pipeline_add_stencil(p, "sobel") != 0 || pipeline_add_nms(p) != 0 ||
+                pipeline_set_hysteresis(p, low, high) != 0) return -1;
+            if (fields == 3) snprintf(label, sizeof(label), "canny%d-%g-%g", radius, low, high);
+            else snprintf(label, sizeof(label), "canny%d", radius);
+        } else if (strcmp(token, "nms") == 0) {
+            if (pipeline_add_nms(p) != 0) return -1;
+            snprintf(label, sizeof(label), "nms");
+        } else if (strncmp(token, "histeresis", 10) == 0 && (token[10] == '\0' || token[10] == ':')) {
+            if (token[10] == ':' && sscanf(token + 11, "%f:%f", &low, &high) != 2) return -1;
+            if (pipeline_set_hysteresis(p, low, high) != 0) return -1;
+            snprintf(label, sizeof(label), "hist%g-%g", low, high);
+        } else {
+            if (pipeline_add_stencil(p, token) != 0) return -1;
+            snprintf(label, sizeof(label), "%s", p->stage[p->stages - 1].stencil.name);
+        }
+
+        size_t used = strlen(p->name);
+        snprintf(p->name + used, sizeof(p->name) - used, "%s%s", used ? "+" : "", label);
+    }
+
+    // Un gradiente sin su supresión no puede cerrar la cadena
+    return (p->stages > 0 && !p->stage[p->stages - 1].gradient) ? 0 : -1;
+}
+
+// Dirección del gradiente cuantizada a 4 sectores: 0 horizontal, 1 diagonal
+// descendente (x e y del mismo signo), 2 vertical, 3 diagonal ascendente
+static inline unsigned char pipeline_direction(float gx, float gy) {
+    float ax = fabsf(gx), ay = fabsf(gy);
+    if (ay <= 0.41421356f * ax) return 0;     // tan(22.5°)
+    if (ay >= 2.41421356f * ax) return 2;     // tan(67.5°)
+    return (gx * gy > 0.0f) ? 1 : 3;
+}
+
+// Describir las etapas para los reportes, p. ej. "gauss2 separable, sobel
+// separable, nms, histéresis 40-100"
+static void pipeline_describe(const Pipeline *p, char *text, size_t size) {
+    size_t used = 0;
+    text[0] = '\0';
+    for (int k = 0; k < p->stages && used < size; k++) {
+        const PipelineStage *stage = &p->stage[k];
+        const char *separator = k ? ", " : "";
+        if (stage->type == PIPELINE_NMS) {
+            used += snprintf(text + used, size - used, "%snms", separator);
+        } else {
+            used += snprintf(text + used, size - used, "%s%s %s", separator, stage->stencil.name,
+                             stencil_method_name(&stage->stencil));
+        }
+    }
+    if (p->hysteresis && used < size) {
+        snprintf(text + used, size - used, ", histéresis %g-%g", p->low, p->high);
+    }
+}
+
+typedef struct PipelineWorker PipelineWorker;
+
+// Estado de trabajo de una etapa
+typedef struct {
+    const PipelineStage *stage;
+    PipelineWorker *owner;
+    int index;
+    int started, last;             // 'last' es la última fila entregada
+    StencilWorker *stencil;        // etapas de filtro
+    unsigned char *gray;           // fila entregada (width)
+    float *magnitude;              // gradiente: magnitud (width) ...
+    unsigned char *direction;      // ... y dirección cuantizada (width)
+    float *ring;                   // supresión: 3 filas de magnitud con un
+                                   // píxel replicado a cada lado (width + 2)
+    unsigned char *ringDirection;  // y sus direcciones (3 x width)
+    int next;                      // siguiente fila (sin recortar) del búfer
+} PipelineStageWorker;
+
+// Estado de trabajo de un hilo para toda la cadena
+struct PipelineWorker {
+    const Pipeline *pipeline;
+    int width, height;
+    stencil_load_fn load;          // filas en gris de la imagen
+    void *ctx;
+    PipelineStageWorker stage[PIPELINE_MAX_STAGES];
+};
+
+static inline size_t pipeline_worker_bytes(const Pipeline *p, int width) {
+    size_t bytes = 0;
+    for (int k = 0; k < p->stages; k++) {
+        const PipelineStage *stage = &p->stage[k];
+        if (stage->type == PIPELINE_STENCIL) bytes += stencil_worker_bytes(&stage->stencil, width);
+        else bytes += 3 * ((size_t)width + 2) * sizeof(float) + 3 * (size_t)width;
+        bytes += stage->gradient ? (size_t)width * (sizeof(float) + 1) : (size_t)width;
+    }
+    return bytes;
+}
+
+static PipelineWorker *pipeline_worker_new(const Pipeline *p, int width, int height) {
+    PipelineWorker *w = calloc(1, sizeof(PipelineWorker));
+    if (w == NULL) {
+        fprintf(stderr, "No se pudo asignar memoria para la cadena %s\n", p->name);
+        exit(1);
+    }
+    w->pipeline = p;
+    w->width = width;
+    w->height = height;
+
+    int failed = 0;
+    for (int k = 0; k < p->stages && !failed; k++) {
+        PipelineStageWorker *sw = &w->stage[k];
+        sw->stage = &p->stage[k];
+        sw->owner = w;
+        sw->index = k;
+        sw->gray = malloc((size_t)width);
+        failed |= (sw->gray == NULL);
+        if (sw->stage->type == PIPELINE_STENCIL) {
+            sw->stencil = stencil_worker_new(&sw->stage->stencil, width, height);
+        } else {
+            sw->ring = malloc(3 * ((size_t)width + 2) * sizeof(float));
+            sw->ringDirection = malloc(3 * (size_t)width);
+            failed |= (sw->ring == NULL || sw->ringDirection == NULL);
+        }
+        if (sw->stage->gradient) {
+            sw->magnitude = malloc((size_t)width * sizeof(float));
+            sw->direction = malloc((size_t)width);
+            failed |= (sw->magnitude == NULL || sw->direction == NULL);
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "No se pudo asignar memoria para la cadena %s\n", p->name);
+        exit(1);
+    }
+    return w;
+}
+
+static void pipeline_worker_free(PipelineWorker *w) {
+    for (int k = 0; k < w->pipeline->stages; k++) {
+        PipelineStageWorker *sw = &w->stage[k];
+        if (sw->stencil != NULL) stencil_worker_free(sw->stencil);
+        free(sw->gray);
+        free(sw->magnitude);
+        free(sw->direction);
+        free(sw->ring);
+        free(sw->ringDirection);
+    }
+    free(w);
+}
+
+static void pipeline_compute(PipelineStageWorker *sw, int y);
+
+// Entregar a una etapa de filtro la fila 'y' de la etapa anterior
+static void pipeline_load_stage(void *ctx, int y, unsigned char *gray) {
+    PipelineStageWorker *sw = ctx;
+    pipeline_compute(sw, y);
+    memcpy(gray, sw->gray, (size_t)sw->owner->width);
+}
+
+// Cargar en el búfer de la supresión la fila (sin recortar) 'y' del gradiente
+static void pipeline_nms_load(PipelineStageWorker *sw, int y) {
+    PipelineWorker *w = sw->owner;
+    PipelineStageWorker *in = &w->stage[sw->index - 1];
+    int width = w->width, slot = ((y % 3) + 3) % 3;
+
+    pipeline_compute(in, y < 0 ? 0 : (y >= w->height ? w->height - 1 : y));
+    float *row = sw->ring + (size_t)slot * (width + 2);
+    memcpy(row + 1, in->magnitude, (size_t)width * sizeof(float));
+    row[0] = row[1];
+    row[width + 1] = row[width];
+    memcpy(sw->ringDirection + (size_t)slot * width, in->direction, (size_t)width);
+}
+
+// Supresión de no máximos de la fila 'y': se conserva la magnitud que supera
+// a sus dos vecinos en la dirección del gradiente (con empate a un lado, para
+// no perder las crestas de dos píxeles). Con histéresis se marca la clase
+// del píxel según los umbrales.
+static void pipeline_nms_row(PipelineStageWorker *sw, int y) {
+    const Pipeline *p = sw->owner->pipeline;
+    int width = sw->owner->width;
+    const float *prev = sw->ring + (size_t)(((y - 1) % 3 + 3) % 3) * (width + 2);
+    const float *cur = sw->ring + (size_t)((y % 3 + 3) % 3) * (width + 2);
+    const float *next = sw->ring + (size_t)(((y + 1) % 3 + 3) % 3) * (width + 2);
+    const unsigned char *direction = sw->ringDirection + (size_t)((y % 3 + 3) % 3) * width;
+
+    for (int x = 0; x < width; x++) {
+        float m = cur[x + 1], a, b;
+        switch (direction[x]) {
+            case 0: a = cur[x]; b = cur[x + 2]; break;
+            case 1: a = prev[x]; b = next[x + 2]; break;
+            case 2: a = prev[x + 1]; b = next[x + 1]; break;
+            default: a = prev[x + 2]; b = next[x]; break;
+        }
+        int keep = (m > a && m >= b);
+
+        int value;
+        if (p->hysteresis) {
+            value = (!keep || m < p->low) ? 0 : (m >= p->high ? 255 : PIPELINE_WEAK);
+        } else {
+            value = !keep ? 0 : (m >= 255.0f ? 255 : (int)m);
+        }
+        sw->gray[x] = (unsigned char)value;
+    }
+}
+
+// Calcular la fila 'y' de una etapa. Cada etapa recibe sus filas en orden
+// creciente (repetidas en los bordes replicados, que se sirven de la copia).
+static void pipeline_compute(PipelineStageWorker *sw, int y) {
+    if (sw->started && sw->last == y) return;
+    PipelineWorker *w = sw->owner;
+    int k = sw->index, width = w->width;
+
+    if (sw->stage->type == PIPELINE_STENCIL) {
+        stencil_load_fn load = k ? pipeline_load_stage : w->load;
+        void *ctx = k ? (void *)&w->stage[k - 1] : w->ctx;
+        if (!sw->started) stencil_start(sw->stencil, load, ctx, y);
+        stencil_step(sw->stencil, load, ctx);
+
+        const Stencil *s = &sw->stage->stencil;
+        const float *a = sw->stencil->result[0], *b = sw->stencil->result[1];
+        if (sw->stage->gradient) {
+            for (int x = 0; x < width; x++) {
+                sw->magnitude[x] = sqrtf(a[x] * a[x] + b[x] * b[x]);
+                sw->direction[x] = pipeline_direction(a[x], b[x]);
+            }
+        } else {
+            for (int x = 0; x < width; x++) sw->gray[x] = (unsigned char)stencil_value(s, a[x], b[x]);
+        }
+    } else {
+        if (!sw->started) sw->next = y - 1;
+        while (sw->next <= y + 1) pipeline_nms_load(sw, sw->next++);
+        pipeline_nms_row(sw, y);
+    }
+
+    sw->started = 1;
+    sw->last = y;
+}
+
+// Aplicar la cadena a las filas [y0, y1) de la imagen. La fila y0 se escribe
+// en 'output' como píxeles RGB grises y las siguientes cada 'rowSize' bytes.
+// 'load' debe poder entregar las filas y0 - R .. y1 + R - 1 que estén dentro
+// de la imagen, con R el radio de la cadena.
+static void pipeline_band(PipelineWorker *w, stencil_load_fn load, void *ctx,
+                          unsigned char *output, int rowSize, int y0, int y1) {
+    const Pipeline *p = w->pipeline;
+    PipelineStageWorker *last = &w->stage[p->stages - 1];
+
+    w->load = load;
+    w->ctx = ctx;
+    for (int k = 0; k < p->stages; k++) w->stage[k].started = 0;
+
+    for (int y = y0; y < y1; y++) {
+        pipeline_compute(last, y);
+        unsigned char *out = output + (size_t)(y - y0) * rowSize;
+        for (int x = 0; x < w->width; x++) {
+            out[x * 3] = last->gray[x];
+            out[x * 3 + 1] = last->gray[x];
+            out[x * 3 + 2] = last->gray[x];
+        }
+    }
+}
+
+// Pila de píxeles (x, y) pendientes de la histéresis
+typedef struct {
+    int *items;
+    size_t count, capacity;
+} PipelineStack;
+
+static void pipeline_push(PipelineStack *stack, int x, int y) {
+    if (stack->count == stack->capacity) {
+        stack->capacity = stack->capacity ? 2 * stack->capacity : 4096;
+        stack->items = realloc(stack->items, stack->capacity * 2 * sizeof(int));
+        if (stack->items == NULL) {
+            fprintf(stderr, "No se pudo asignar memoria para la histéresis\n");
+            exit(1);
+        }
+    }
+    stack->items[2 * stack->count] = x;
+    stack->items[2 * stack->count + 1] = y;
+    stack->count++;
+}
+
+// Histéresis: los bordes débiles conectados (8-vecindad) con uno fuerte
+// pasan a fuertes. Se parte de los bordes fuertes de las filas [s0, s1) y
+// solo se recorren las 'rows' filas de 'image' (píxeles RGB, 'rowSize' bytes
+// por fila). Devuelve el número de píxeles promovidos.
+static long pipeline_grow(unsigned char *image, int width, int rowSize, int rows, int s0, int s1) {
+    PipelineStack stack = { NULL, 0, 0 };
+    long promoted = 0;
+
+    if (s0 < 0) s0 = 0;
+    if (s1 > rows) s1 = rows;
+    for (int y = s0; y < s1; y++) {
+        for (int x = 0; x < width; x++) {
+            if (image[(size_t)y * rowSize + x * 3] == 255) pipeline_push(&stack, x, y);
+        }
+    }
+
+    while (stack.count > 0) {
+        stack.count--;
+        int x = stack.items[2 * stack.count], y = stack.items[2 * stack.count + 1];
+        for (int yy = (y > 0 ? y - 1 : 0); yy <= y + 1 && yy < rows; yy++) {
+            for (int xx = (x > 0 ? x - 1 : 0); xx <= x + 1 && xx < width; xx++) {
+                unsigned char *pixel = image + (size_t)yy * rowSize + xx * 3;
+                if (*pixel != PIPELINE_WEAK) continue;
+                *pixel = 255;
+                promoted++;
+                pipeline_push(&stack, xx, yy);
+            }
+        }
+    }
+
+    free(stack.items);
+    return promoted;
+}
+
+// Promover los bordes débiles de 'row' que tocan un borde fuerte de la fila
+// vecina 'neighbour' (de otra franja o banda). Devuelve cuántos se promovieron.
+static inline long pipeline_grow_across(unsigned char *row, const unsigned char *neighbour, int width) {
+    long promoted = 0;
+    for (int x = 0; x < width; x++) {
+        if (row[x * 3] != PIPELINE_WEAK) continue;
+        int strong = (neighbour[x * 3] == 255);
+        if (x > 0) strong |= (neighbour[(x - 1) * 3] == 255);
+        if (x < width - 1) strong |= (neighbour[(x + 1) * 3] == 255);
+        if (strong) {
+            row[x * 3] = 255;
+            promoted++;
+        }
+    }
+    return promoted;
+}
+
+// Descartar los bordes débiles que no se conectaron con uno fuerte
+static void pipeline_finish(unsigned char *image, int width, int rowSize, int rows) {
+    for (int y = 0; y < rows; y++) {
+        unsigned char *row = image + (size_t)y * rowSize;
+        for (int x = 0; x < width; x++) {
+            unsigned char value = (row[x * 3] == 255) ? 255 : 0;
+            row[x * 3] = value;
+            row[x * 3 + 1] = value;
+            row[x * 3 + 2] = value;
+        }
+    }
+}
+
+#endif // PIPELINE_H
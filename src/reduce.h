@@ -0,0 +1,558 @@
+// reduce.h
+// Reducciones locales sobre bloques de elementos int32, int64 o double:
+// suma, suma compensada (Kahan), mínimo, máximo, posición del máximo, media
+// y varianza. Los núcleos tienen una versión escalar y versiones AVX2
+// seleccionadas en tiempo de ejecución, y los resultados parciales de cada
+// proceso se combinan con operaciones MPI propias (MPI_Op_create).
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <mpi.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define REDUCE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+typedef enum { REDUCE_INT32, REDUCE_INT64, REDUCE_DOUBLE } ReduceType;
+typedef enum { REDUCE_SUM, REDUCE_KAHAN, REDUCE_MIN, REDUCE_MAX, REDUCE_ARGMAX, REDUCE_MEAN, REDUCE_VAR } ReduceOp;
+
+// Suma compensada: 'c' guarda los bits perdidos al redondear 'sum'
+typedef struct { double sum; double c; } reduce_kahan;
+
+// Media y suma de cuadrados de las desviaciones (M2) de n elementos
+typedef struct { int64_t n; double mean; double m2; } reduce_welford;
+
+// Valor máximo y su posición global (-1 si no hay elementos)
+typedef struct { int64_t value; int64_t index; } reduce_loc_int64;
+typedef struct { double value; int64_t index; } reduce_loc_double;
+
+// Resultado de una reducción. Según el tipo y la operación se usa 'i'
+// (suma, mínimo o máximo de enteros), 'd' (lo mismo en double), 'kahan',
+// 'loc_i'/'loc_d' o 'stats'.
+typedef struct {
+    ReduceType type;
+    ReduceOp op;
+    int64_t i;
+    double d;
+    reduce_kahan kahan;
+    reduce_loc_int64 loc_i;
+    reduce_loc_double loc_d;
+    reduce_welford stats;
+} reduce_state;
+
+// Núcleos escalares de un tipo: suma con cuatro acumuladores, mínimo,
+// máximo y suma de (x - mean)^2
+#define REDUCE_DEFINE(NAME, TYPE, SUM_TYPE)                                                 \
+    static SUM_TYPE reduce_sum_##NAME##_scalar(const TYPE *x, int n) {                      \
+        SUM_TYPE acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;                                    \
+        int i = 0;                                                                          \
+        for (; i + 4 <= n; i += 4) {                                                        \
+            acc0 += x[i];                                                                   \
+            acc1 += x[i + 1];                                                               \
+            acc2 += x[i + 2];                                                               \
+            acc3 += x[i + 3];                                                               \
+        }                                                                                   \
+        for (; i < n; i++) acc0 += x[i];                                                    \
+        return (acc0 + acc1) + (acc2 + acc3);                                               \
+    }                                                                                       \
+    static TYPE reduce_min_##NAME##_scalar(const TYPE *x, int n, TYPE init) {               \
+        TYPE m = init;                                                                      \
+        for (int i = 0; i < n; i++) m = (x[i] < m) ? x[i] : m;                              \
+        return m;                                                                           \
+    }                                                                                       \
+    static TYPE reduce_max_##NAME##_scalar(const TYPE *x, int n, TYPE init) {               \
+        TYPE m = init;                                                                      \
+        for (int i = 0; i < n; i++) m = (x[i] > m) ? x[i] : m;                              \
+        return m;                                                                           \
+    }                                                                                       \
+    static double reduce_sqdev_##NAME##_scalar(const TYPE *x, int n, double mean) {         \
+        double acc0 = 0, acc1 = 0;                                                          \
+        int i = 0;                                                                          \
+        for (; i + 2 <= n; i += 2) {                                                        \
+            double d0 = (double)x[i] - mean, d1 = (double)x[i + 1] - mean;                  \
+            acc0 += d0 * d0;                                                                \
+            acc1 += d1 * d1;                                                                \
+        }                                                                                   \
+        for (; i < n; i++) acc0 += ((double)x[i] - mean) * ((double)x[i] - mean);           \
+        return acc0 + acc1;                                                                 \
+    }                                                                                       \
+    static SUM_TYPE (*reduce_sum_##NAME)(const TYPE *, int) = reduce_sum_##NAME##_scalar;    \
+    static TYPE (*reduce_min_##NAME)(const TYPE *, int, TYPE) = reduce_min_##NAME##_scalar;  \
+    static TYPE (*reduce_max_##NAME)(const TYPE *, int, TYPE) = reduce_max_##NAME##_scalar;  \
+    static double (*reduce_sqdev_##NAME)(const TYPE *, int, double) = reduce_sqdev_##NAME##_scalar;
+
+REDUCE_DEFINE(int32, int32_t, int64_t)
+REDUCE_DEFINE(int64, int64_t, int64_t)
+REDUCE_DEFINE(double, double, double)
+
+// Sumar dos valores con compensación (variante de Neumaier, que también es
+// correcta cuando el sumando es mayor que la suma acumulada)
+static inline void reduce_kahan_add(reduce_kahan *k, double x) {
+    double t = k->sum + x;
+    if (fabs(k->sum) >= fabs(x)) {
+        k->c += (k->sum - t) + x;
+    } else {
+        k->c += (x - t) + k->sum;
+    }
+    k->sum = t;
+}
+
+static void reduce_kahan_double_scalar(const double *x, int n, reduce_kahan *k) {
+    for (int i = 0; i < n; i++) reduce_kahan_add(k, x[i]);
+}
+
+static void (*reduce_kahan_double)(const double *, int, reduce_kahan *) = reduce_kahan_double_scalar;
+
+#ifdef REDUCE_SIMD_X86
+
+// Versiones AVX2. Las sumas de int32 se extienden a 64 bits antes de
+// acumular, así que no desbordan; el orden de las sumas de double cambia
+// respecto a la versión escalar, por lo que el resultado puede diferir en
+// el último bit.
+__attribute__((target("avx2")))
+static int64_t reduce_sum_int32_avx2(const int32_t *x, int n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(x + i + 4));
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(lo));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(hi));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    int64_t sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += x[i];
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static int64_t reduce_sum_int64_avx2(const int64_t *x, int n) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i *)(x + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i *)(x + i + 4)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    int64_t sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += x[i];
+    return sum;
+}
+
+__attribute__((target("avx2")))
+static double reduce_sum_double_avx2(const double *x, int n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(x + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(x + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += x[i];
+    return sum;
+}
+
+// Mínimo y máximo: los de int32 y double tienen instrucción propia; para
+// int64 AVX2 solo ofrece la comparación, así que se combina con blendv
+__attribute__((target("avx2")))
+static int32_t reduce_min_int32_avx2(const int32_t *x, int n, int32_t init) {
+    __m256i m = _mm256_set1_epi32(init);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i *)(x + i)));
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, m);
+    return reduce_min_int32_scalar(x + i, n - i, reduce_min_int32_scalar(lanes, 8, init));
+}
+
+__attribute__((target("avx2")))
+static int32_t reduce_max_int32_avx2(const int32_t *x, int n, int32_t init) {
+    __m256i m = _mm256_set1_epi32(init);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) m = _mm256_max_epi32(m, _mm256_loadu_si256((const __m256i *)(x + i)));
+    int32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, m);
+    return reduce_max_int32_scalar(x + i, n - i, reduce_max_int32_scalar(lanes, 8, init));
+}
+
+__attribute__((target("avx2")))
+static int64_t reduce_min_int64_avx2(const int64_t *x, int n, int64_t init) {
+    __m256i m = _mm256_set1_epi64x(init);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(m, v));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, m);
+    return reduce_min_int64_scalar(x + i, n - i, reduce_min_int64_scalar(lanes, 4, init));
+}
+
+__attribute__((target("avx2")))
+static int64_t reduce_max_int64_avx2(const int64_t *x, int n, int64_t init) {
+    __m256i m = _mm256_set1_epi64x(init);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        m = _mm256_blendv_epi8(m, v, _mm256_cmpgt_epi64(v, m));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, m);
+    return reduce_max_int64_scalar(x + i, n - i, reduce_max_int64_scalar(lanes, 4, init));
+}
+
+__attribute__((target("avx2")))
+static double reduce_min_double_avx2(const double *x, int n, double init) {
+    __m256d m = _mm256_set1_pd(init);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) m = _mm256_min_pd(m, _mm256_loadu_pd(x + i));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, m);
+    return reduce_min_double_scalar(x + i, n - i, reduce_min_double_scalar(lanes, 4, init));
+}
+
+__attribute__((target("avx2")))
+static double reduce_max_double_avx2(const double *x, int n, double init) {
+    __m256d m = _mm256_set1_pd(init);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) m = _mm256_max_pd(m, _mm256_loadu_pd(x + i));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, m);
+    return reduce_max_double_scalar(x + i, n - i, reduce_max_double_scalar(lanes, 4, init));
+}
+
+// Suma de (x - mean)^2 en double; los int32 se convierten de 4 en 4
+__attribute__((target("avx2,fma")))
+static double reduce_sqdev_int32_avx2(const int32_t *x, int n, double mean) {
+    __m256d vmean = _mm256_set1_pd(mean);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(x + i))), vmean);
+        __m256d d1 = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(x + i + 4))), vmean);
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + reduce_sqdev_int32_scalar(x + i, n - i, mean);
+}
+
+__attribute__((target("avx2,fma")))
+static double reduce_sqdev_double_avx2(const double *x, int n, double mean) {
+    __m256d vmean = _mm256_set1_pd(mean);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(x + i), vmean);
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(x + i + 4), vmean);
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + reduce_sqdev_double_scalar(x + i, n - i, mean);
+}
+
+// Suma compensada con cuatro sumas y cuatro compensaciones independientes
+// (Kahan clásico por carril: los elementos de un bloque son pequeños frente
+// a la suma), que al final se combinan con reduce_kahan_add. No debe
+// compilarse con -ffast-math, que eliminaría la compensación.
+__attribute__((target("avx2")))
+static void reduce_kahan_double_avx2(const double *x, int n, reduce_kahan *k) {
+    __m256d sum = _mm256_setzero_pd(), c = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d y = _mm256_sub_pd(_mm256_loadu_pd(x + i), c);
+        __m256d t = _mm256_add_pd(sum, y);
+        c = _mm256_sub_pd(_mm256_sub_pd(t, sum), y);
+        sum = t;
+    }
+    double sums[4], comps[4];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(comps, c);
+    for (int l = 0; l < 4; l++) {
+        reduce_kahan_add(k, sums[l]);
+        reduce_kahan_add(k, -comps[l]);
+    }
+    reduce_kahan_double_scalar(x + i, n - i, k);
+}
+
+#endif // REDUCE_SIMD_X86
+
+// Seleccionar los núcleos más rápidos soportados por la CPU. La variable de
+// entorno REDUCE_SIMD=scalar fuerza la versión escalar.
+static void reduce_select(const char **name) {
+    const char *forced = getenv("REDUCE_SIMD");
+    const char *kernelName = "scalar";
+
+#ifdef REDUCE_SIMD_X86
+    __builtin_cpu_init();
+    if (!(forced && strcmp(forced, "scalar") == 0)) {
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            reduce_sum_int32 = reduce_sum_int32_avx2;
+            reduce_sum_int64 = reduce_sum_int64_avx2;
+            reduce_sum_double = reduce_sum_double_avx2;
+            reduce_min_int32 = reduce_min_int32_avx2;
+            reduce_max_int32 = reduce_max_int32_avx2;
+            reduce_min_int64 = reduce_min_int64_avx2;
+            reduce_max_int64 = reduce_max_int64_avx2;
+            reduce_min_double = reduce_min_double_avx2;
+            reduce_max_double = reduce_max_double_avx2;
+            reduce_sqdev_int32 = reduce_sqdev_int32_avx2;
+            reduce_sqdev_double = reduce_sqdev_double_avx2;
+            reduce_kahan_double = reduce_kahan_double_avx2;
+            kernelName = "avx2";
+        }
+    }
+#else
+    (void)forced;
+#endif
+
+    if (name) *name = kernelName;
+}
+
+// Combinar las estadísticas de dos conjuntos (fórmula de Chan et al.)
+static inline void reduce_welford_merge(reduce_welford *a, const reduce_welford *b) {
+    if (b->n == 0) return;
+    if (a->n == 0) { *a = *b; return; }
+    int64_t n = a->n + b->n;
+    double delta = b->mean - a->mean;
+    a->mean += delta * ((double)b->n / (double)n);
+    a->m2 += b->m2 + delta * delta * ((double)a->n * (double)b->n / (double)n);
+    a->n = n;
+}
+
+// Estado inicial (elemento neutro) de la reducción
+static void reduce_init(reduce_state *s, ReduceType type, ReduceOp op) {
+    memset(s, 0, sizeof(*s));
+    s->type = type;
+    s->op = op;
+    if (op == REDUCE_MIN) {
+        s->i = (type == REDUCE_INT32) ? INT32_MAX : INT64_MAX;
+        s->d = INFINITY;
+    } else if (op == REDUCE_MAX) {
+        s->i = (type == REDUCE_INT32) ? INT32_MIN : INT64_MIN;
+        s->d = -INFINITY;
+    }
+    s->loc_i = (reduce_loc_int64){ INT64_MIN, -1 };
+    s->loc_d = (reduce_loc_double){ -INFINITY, -1 };
+}
+
+// Suma y suma de (x - mean)^2 de un bloque de cualquier tipo, en double
+static double reduce_block_sum(ReduceType type, const void *data, int n) {
+    switch (type) {
+        case REDUCE_INT32: return (double)reduce_sum_int32(data, n);
+        case REDUCE_INT64: return (double)reduce_sum_int64(data, n);
+        default: return reduce_sum_double(data, n);
+    }
+}
+
+static double reduce_block_sqdev(ReduceType type, const void *data, int n, double mean) {
+    switch (type) {
+        case REDUCE_INT32: return reduce_sqdev_int32(data, n, mean);
+        case REDUCE_INT64: return reduce_sqdev_int64(data, n, mean);
+        default: return reduce_sqdev_double(data, n, mean);
+    }
+}
+
+// Acumular un bloque de n elementos cuyo primer elemento tiene la posición
+// global 'first'
+static void reduce_chunk(reduce_state *s, const void *data, int n, int64_t first) {
+    if (n <= 0) return;
+    switch (s->op) {
+        case REDUCE_SUM:
+        case REDUCE_KAHAN:
+            if (s->type == REDUCE_INT32) s->i += reduce_sum_int32(data, n);
+            else if (s->type == REDUCE_INT64) s->i += reduce_sum_int64(data, n);
+            else if (s->op == REDUCE_SUM) s->d += reduce_sum_double(data, n);
+            else reduce_kahan_double(data, n, &s->kahan);
+            break;
+        case REDUCE_MIN:
+            if (s->type == REDUCE_INT32) s->i = reduce_min_int32(data, n, (int32_t)s->i);
+            else if (s->type == REDUCE_INT64) s->i = reduce_min_int64(data, n, s->i);
+            else s->d = reduce_min_double(data, n, s->d);
+            break;
+        case REDUCE_MAX:
+            if (s->type == REDUCE_INT32) s->i = reduce_max_int32(data, n, (int32_t)s->i);
+            else if (s->type == REDUCE_INT64) s->i = reduce_max_int64(data, n, s->i);
+            else s->d = reduce_max_double(data, n, s->d);
+            break;
+        case REDUCE_ARGMAX: {
+            // Máximo vectorizado del bloque y después búsqueda de su primera
+            // aparición, mientras el bloque sigue en caché
+            int at = -1;
+            if (s->type == REDUCE_DOUBLE) {
+                const double *x = data;
+                double m = reduce_max_double(x, n, -INFINITY);
+                if (m > s->loc_d.value || s->loc_d.index < 0) {
+                    for (at = 0; at < n && x[at] != m; at++) {}
+                    if (at < n) s->loc_d = (reduce_loc_double){ m, first + at };
+                }
+            } else {
+                int64_t m;
+                if (s->type == REDUCE_INT32) m = reduce_max_int32(data, n, INT32_MIN);
+                else m = reduce_max_int64(data, n, INT64_MIN);
+                if (m > s->loc_i.value || s->loc_i.index < 0) {
+                    if (s->type == REDUCE_INT32) {
+                        const int32_t *x = data;
+                        for (at = 0; x[at] != m; at++) {}
+                    } else {
+                        const int64_t *x = data;
+                        for (at = 0; x[at] != m; at++) {}
+                    }
+                    s->loc_i = (reduce_loc_int64){ m, first + at };
+                }
+            }
+            break;
+        }
+        case REDUCE_MEAN:
+        case REDUCE_VAR: {
+            // Media y M2 del bloque en dos pasadas (el bloque cabe en caché)
+            // y combinación con las estadísticas acumuladas
+            reduce_welford block = { n, reduce_block_sum(s->type, data, n) / n, 0.0 };
+            block.m2 = reduce_block_sqdev(s->type, data, n, block.mean);
+            reduce_welford_merge(&s->stats, &block);
+            break;
+        }
+    }
+}
+
+// Operaciones MPI para los resultados que no tienen operación predefinida
+static MPI_Datatype reduce_kahan_type, reduce_welford_type, reduce_loc_int64_type, reduce_loc_double_type;
+
+static void reduce_kahan_op(void *in, void *inout, int *len, MPI_Datatype *type) {
+    reduce_kahan *a = in, *b = inout;
+    (void)type;
+    for (int i = 0; i < *len; i++) {
+        reduce_kahan r = b[i];
+        reduce_kahan_add(&r, a[i].sum);
+        reduce_kahan_add(&r, a[i].c);
+        b[i] = r;
+    }
+}
+
+static void reduce_welford_op(void *in, void *inout, int *len, MPI_Datatype *type) {
+    reduce_welford *a = in, *b = inout;
+    (void)type;
+    for (int i = 0; i < *len; i++) {
+        reduce_welford r = a[i];
+        reduce_welford_merge(&r, &b[i]);
+        b[i] = r;
+    }
+}
+
+// Máximo con su posición; ante empates gana la posición menor, igual que
+// MPI_MAXLOC, pero con índices de 64 bits
+static void reduce_argmax_op(void *in, void *inout, int *len, MPI_Datatype *type) {
+    if (*type == reduce_loc_double_type) {
+        reduce_loc_double *a = in, *b = inout;
+        for (int i = 0; i < *len; i++) {
+            if (a[i].index < 0) continue;
+            if (b[i].index < 0 || a[i].value > b[i].value ||
+                (a[i].value == b[i].value && a[i].index < b[i].index)) {
+                b[i] = a[i];
+            }
+        }
+    } else {
+        reduce_loc_int64 *a = in, *b = inout;
+        for (int i = 0; i < *len; i++) {
+            if (a[i].index < 0) continue;
+            if (b[i].index < 0 || a[i].value > b[i].value ||
+                (a[i].value == b[i].value && a[i].index < b[i].index)) {
+                b[i] = a[i];
+            }
+        }
+    }
+}
+
+static MPI_Datatype reduce_struct_type(MPI_Datatype first, MPI_Aint offset_first,
+                                       MPI_Datatype second, MPI_Aint offset_second,
+                                       MPI_Datatype third, MPI_Aint offset_third, int fields, MPI_Aint extent) {
+    int lengths[3] = { 1, 1, 1 };
+    MPI_Aint offsets[3] = { offset_first, offset_second, offset_third };
+    MPI_Datatype types[3] = { first, second, third }, packed, resized;
+    MPI_Type_create_struct(fields, lengths, offsets, types, &packed);
+    MPI_Type_create_resized(packed, 0, extent, &resized);
+    MPI_Type_free(&packed);
+    MPI_Type_commit(&resized);
+    return resized;
+}
+
+// Combinar los resultados parciales de todos los procesos en 'root' (o en
+// todos si all != 0)
+static void reduce_combine(const reduce_state *local, reduce_state *result, int all, int root, MPI_Comm comm) {
+    reduce_kahan_type = reduce_struct_type(MPI_DOUBLE, offsetof(reduce_kahan, sum),
+                                           MPI_DOUBLE, offsetof(reduce_kahan, c),
+                                           MPI_DATATYPE_NULL, 0, 2, sizeof(reduce_kahan));
+    reduce_welford_type = reduce_struct_type(MPI_INT64_T, offsetof(reduce_welford, n),
+                                             MPI_DOUBLE, offsetof(reduce_welford, mean),
+                                             MPI_DOUBLE, offsetof(reduce_welford, m2), 3, sizeof(reduce_welford));
+    reduce_loc_int64_type = reduce_struct_type(MPI_INT64_T, offsetof(reduce_loc_int64, value),
+                                               MPI_INT64_T, offsetof(reduce_loc_int64, index),
+                                               MPI_DATATYPE_NULL, 0, 2, sizeof(reduce_loc_int64));
+    reduce_loc_double_type = reduce_struct_type(MPI_DOUBLE, offsetof(reduce_loc_double, value),
+                                                MPI_INT64_T, offsetof(reduce_loc_double, index),
+                                                MPI_DATATYPE_NULL, 0, 2, sizeof(reduce_loc_double));
+
+    const void *send;
+    void *recv;
+    MPI_Datatype type;
+    MPI_Op op = MPI_OP_NULL, custom = MPI_OP_NULL;
+    int isDouble = (local->type == REDUCE_DOUBLE);
+
+    *result = *local;
+    switch (local->op) {
+        case REDUCE_SUM:
+        case REDUCE_MIN:
+        case REDUCE_MAX:
+            send = isDouble ? (const void *)&local->d : (const void *)&local->i;
+            recv = isDouble ? (void *)&result->d : (void *)&result->i;
+            type = isDouble ? MPI_DOUBLE : MPI_INT64_T;
+            op = (local->op == REDUCE_SUM) ? MPI_SUM : (local->op == REDUCE_MIN) ? MPI_MIN : MPI_MAX;
+            break;
+        case REDUCE_KAHAN:
+            if (isDouble) {
+                send = &local->kahan; recv = &result->kahan; type = reduce_kahan_type;
+                MPI_Op_create(reduce_kahan_op, 1, &custom);
+            } else {
+                send = &local->i; recv = &result->i; type = MPI_INT64_T; op = MPI_SUM;
+            }
+            break;
+        case REDUCE_ARGMAX:
+            send = isDouble ? (const void *)&local->loc_d : (const void *)&local->loc_i;
+            recv = isDouble ? (void *)&result->loc_d : (void *)&result->loc_i;
+            type = isDouble ? reduce_loc_double_type : reduce_loc_int64_type;
+            MPI_Op_create(reduce_argmax_op, 1, &custom);
+            break;
+        default:
+            // La combinación de Chan no es conmutativa en coma flotante
+            send = &local->stats; recv = &result->stats; type = reduce_welford_type;
+            MPI_Op_create(reduce_welford_op, 0, &custom);
+            break;
+    }
+    if (custom != MPI_OP_NULL) op = custom;
+
+    if (all) {
+        MPI_Allreduce(send, recv, 1, type, op, comm);
+    } else {
+        MPI_Reduce(send, recv, 1, type, op, root, comm);
+    }
+
+    if (custom != MPI_OP_NULL) MPI_Op_free(&custom);
+    MPI_Type_free(&reduce_kahan_type);
+    MPI_Type_free(&reduce_welford_type);
+    MPI_Type_free(&reduce_loc_int64_type);
+    MPI_Type_free(&reduce_loc_double_type);
+}
+
+#endif // REDUCE_H
@@ -5,279 +5,871 @@
 #include <mpi.h>
 #include <math.h>
 #include <sys/resource.h>
+#include <limits.h>
+#include <unistd.h>
+#include "bmp_io.h"
+#include "sobel_simd.h"
+#include "pipeline.h"
+#include "bench.h"
+#include "mpi_trace.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Etiquetas para el intercambio de filas fantasma entre procesos vecinos
+#define HALO_TAG_UP   100
+#define HALO_TAG_DOWN 101
+
+// Píxeles por bloque al calcular la magnitud de una fila
+#define SOBEL_CHUNK 256
+
+// Filas por bloque de trabajo de cada hilo en el modo híbrido MPI+OpenMP
+#define HYBRID_BLOCK_ROWS 32
+
+// Núcleo de magnitud Sobel elegido en tiempo de ejecución
+static sobel_mag_fn sobel_mag;
+
+// Cadena de filtros elegida con -f (NULL: Sobel clásico) y prefijo de los
+// archivos de salida
+static Pipeline *pipeline;
+static Pipeline selectedPipeline;
+static char outputPrefix[64] = "sobel_mpi_";
+
+// Aplicar el filtro Sobel a la fila 'cur' usando sus filas vecinas en gris.
+// La magnitud se calcula por bloques con el núcleo seleccionado para la CPU
+// y luego se replica en los tres canales de la fila de salida.
+void sobel_row(const unsigned char *prev, const unsigned char *cur, const unsigned char *next,
+               unsigned char *out, int width) {
+    unsigned char mag[SOBEL_CHUNK];
+
+    for (int x = 1; x < width - 1; x += SOBEL_CHUNK) {
+        int n = (width - 1 - x < SOBEL_CHUNK) ? width - 1 - x : SOBEL_CHUNK;
+        sobel_mag(prev + x, cur + x, next + x, mag, n);
+
+        for (int i = 0; i < n; i++) {
+            int pos_rgb = (x + i) * 3;
+            out[pos_rgb] = mag[i];
+            out[pos_rgb + 1] = mag[i];
+            out[pos_rgb + 2] = mag[i];
+        }
+    }
+}
 
-// Estructuras para manejar el encabezado BMP
-#pragma pack(push, 1)
-typedef struct {
-    unsigned short type;       // Tipo de archivo (debe ser 'BM' para un archivo BMP válido)
-    unsigned int size;         // Tamaño del archivo en bytes
-    unsigned short reserved1;
-    unsigned short reserved2;
-    unsigned int offset;       // Desplazamiento a los datos de píxeles
-} BMPHeader;
+// Aplicar el filtro Sobel a las filas locales [start, end) en una sola pasada.
+// Las filas start - 1 .. end deben pertenecer a la franja; se convierten a gris
+// bajo demanda en el búfer circular 'lines' de tres filas.
+void sobel_rows(const unsigned char *data, unsigned char *newdata, unsigned char *lines,
+                int width, int rowSize, int start, int end) {
+    if (start >= end) return;
 
-typedef struct {
-    unsigned int size;           // Tamaño de esta estructura en bytes
-    int width;                   // Ancho de la imagen en píxeles
-    int height;                  // Altura de la imagen en píxeles
-    unsigned short planes;       // Número de planos de color (debe ser 1)
-    unsigned short bitCount;     // Número de bits por píxel
-    unsigned int compression;    // Método de compresión utilizado
-    unsigned int imageSize;      // Tamaño de los datos de imagen en bytes
-    int xPixelsPerMeter;         // Resolución horizontal en píxeles por metro
-    int yPixelsPerMeter;         // Resolución vertical en píxeles por metro
-    unsigned int colorsUsed;     // Número de colores en la paleta
-    unsigned int colorsImportant;// Número de colores importantes
-} BMPInfoHeader;
-#pragma pack(pop)
-
-// Función para aplicar el filtro Sobel en una porción de la imagen
-void sobel_filter(unsigned char *data, BMPInfoHeader infoHeader, unsigned char *newdata, int start, int end) {
+    sobel_gray_row(data + (size_t)(start - 1) * rowSize, lines + ((start - 1) % 3) * width, width);
+    sobel_gray_row(data + (size_t)start * rowSize, lines + (start % 3) * width, width);
+
+    for (int y = start; y < end; y++) {
+        sobel_gray_row(data + (size_t)(y + 1) * rowSize, lines + ((y + 1) % 3) * width, width);
+        sobel_row(lines + ((y - 1) % 3) * width, lines + (y % 3) * width, lines + ((y + 1) % 3) * width,
+                  newdata + (size_t)y * rowSize, width);
+    }
+}
+
+// Función para aplicar el filtro Sobel en una franja de la imagen.
+// La franja empieza en la fila global 'firstRow' y tiene 'localHeight' filas;
+// 'up' y 'down' son los procesos vecinos (MPI_PROC_NULL en los bordes).
+// Las filas de frontera en gris se intercambian con los vecinos de forma
+// no bloqueante mientras se calcula el interior de la franja.
+void sobel_filter(const unsigned char *data, BMPInfoHeader infoHeader, unsigned char *newdata,
+                  int firstRow, int localHeight, int up, int down) {
     int width = infoHeader.width;
     int rowSize = ((width * 3 + 3) & (~3)); // Alineación a 4 bytes
     int height = abs(infoHeader.height);
 
-    int Gx[3][3] = {
-        {-1, 0, 1},
-        {-2, 0, 2},
-        {-1, 0, 1}
-    };
-    int Gy[3][3] = {
-        {-1, -2, -1},
-        { 0,  0,  0},
-        { 1,  2,  1}
-    };
-
-    unsigned char *grayData = (unsigned char *)malloc(width * height);
+    // Siete filas en gris: fantasma superior, primera y última fila de la
+    // franja, fantasma inferior y el búfer circular de tres filas
+    unsigned char *grayData = (unsigned char *)calloc((size_t)7 * width, 1);
     if (grayData == NULL) {
         fprintf(stderr, "Error al asignar memoria para grayData.\n");
         MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    unsigned char *haloTop = grayData;
+    unsigned char *firstGray = grayData + width;
+    unsigned char *lastGray = grayData + 2 * width;
+    unsigned char *haloBottom = grayData + 3 * width;
+    unsigned char *lines = grayData + 4 * width;
+
+    // Convertir primero las filas de frontera para poder enviarlas cuanto antes
+    sobel_gray_row(data, firstGray, width);
+    sobel_gray_row(data + (size_t)(localHeight - 1) * rowSize, lastGray, width);
+
+    MPI_Request requests[4];
+    MPI_Irecv(haloTop, width, MPI_UNSIGNED_CHAR, up, HALO_TAG_DOWN, MPI_COMM_WORLD, &requests[0]);
+    MPI_Irecv(haloBottom, width, MPI_UNSIGNED_CHAR, down, HALO_TAG_UP, MPI_COMM_WORLD, &requests[1]);
+    MPI_Isend(firstGray, width, MPI_UNSIGNED_CHAR, up, HALO_TAG_UP, MPI_COMM_WORLD, &requests[2]);
+    MPI_Isend(lastGray, width, MPI_UNSIGNED_CHAR, down, HALO_TAG_DOWN, MPI_COMM_WORLD, &requests[3]);
+
+    // Rango de filas locales a calcular: las filas globales 0 y height - 1 no tienen vecinos
+    int start = (firstRow == 0) ? 1 : 0;
+    int end = (firstRow + localHeight == height) ? localHeight - 1 : localHeight;
+
+    // Interior de la franja: no depende de las filas fantasma
+    int innerStart = (start > 1) ? start : 1;
+    int innerEnd = (end < localHeight - 1) ? end : localHeight - 1;
+
+#ifdef _OPENMP
+    // Modo híbrido: el interior se reparte en bloques de filas entre los hilos
+    // OpenMP. Solo el hilo maestro llama a MPI (MPI_THREAD_FUNNELED): completa
+    // el intercambio de filas fantasma mientras los demás hilos calculan, y
+    // después se une al reparto dinámico de bloques.
+    int blocks = (innerEnd > innerStart) ? (innerEnd - innerStart + HYBRID_BLOCK_ROWS - 1) / HYBRID_BLOCK_ROWS : 0;
+
+    #pragma omp parallel
+    {
+        unsigned char *threadLines = (unsigned char *)malloc((size_t)3 * width);
+
+        #pragma omp master
+        MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+
+        #pragma omp for schedule(dynamic) nowait
+        for (int b = 0; b < blocks; b++) {
+            int blockStart = innerStart + b * HYBRID_BLOCK_ROWS;
+            int blockEnd = (blockStart + HYBRID_BLOCK_ROWS < innerEnd) ? blockStart + HYBRID_BLOCK_ROWS : innerEnd;
+            sobel_rows(data, newdata, threadLines, width, rowSize, blockStart, blockEnd);
+        }
 
-    // Convertir a escala de grises
-    for (int y = start; y < end; y++) {
-        for (int x = 0; x < width; x++) {
-            int pos_rgb = y * rowSize + x * 3;
-            int pos_gray = y * width + x;
-            unsigned char blue = data[pos_rgb];
-            unsigned char green = data[pos_rgb + 1];
-            unsigned char red = data[pos_rgb + 2];
-            unsigned char gray = (unsigned char)(0.3 * red + 0.59 * green + 0.11 * blue);
-            grayData[pos_gray] = gray;
+        free(threadLines);
+    }
+#else
+    sobel_rows(data, newdata, lines, width, rowSize, innerStart, innerEnd);
+
+    MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+#endif
+
+    // Filas de frontera, que necesitan las filas de los vecinos. Si la franja
+    // es la última y tiene una sola fila, start == end == 0 y no hay nada que
+    // calcular: esa fila es el borde inferior de la imagen
+    if (start == 0 && end > 0) {
+        unsigned char *next = haloBottom;
+        if (localHeight > 1) {
+            next = lines;
+            sobel_gray_row(data + rowSize, next, width);
         }
+        sobel_row(haloTop, firstGray, next, newdata, width);
+    }
+    if (end == localHeight && start < end && localHeight > 1) {
+        unsigned char *prev = firstGray;
+        if (localHeight > 2) {
+            prev = lines;
+            sobel_gray_row(data + (size_t)(localHeight - 2) * rowSize, prev, width);
+        }
+        sobel_row(prev, lastGray, haloBottom, newdata + (size_t)(localHeight - 1) * rowSize, width);
     }
 
-    // Aplicar el filtro Sobel
-    for (int y = start + 1; y < end - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            int gx = 0;
-            int gy = 0;
+    free(grayData);
+}
 
-            for (int i = -1; i <=1; i++) {
-                for (int j = -1; j <=1; j++) {
-                    int pixel = grayData[(y + i) * width + (x + j)];
-                    gx += Gx[i + 1][j + 1] * pixel;
-                    gy += Gy[i + 1][j + 1] * pixel;
-                }
-            }
+// Filas de una franja para la cadena de filtros: las propias se convierten
+// a gris desde la entrada y las de los vecinos vienen del intercambio de
+// filas fantasma ('radius' filas en gris por lado)
+typedef struct {
+    const unsigned char *data;
+    int width, rowSize;
+    int firstRow, localHeight, radius;
+    const unsigned char *haloTop, *haloBottom;
+} StripRows;
+
+void load_strip_row(void *ctx, int y, unsigned char *gray) {
+    const StripRows *strip = ctx;
+    int local = y - strip->firstRow;
+    if (local < 0) {
+        memcpy(gray, strip->haloTop + (size_t)(local + strip->radius) * strip->width, strip->width);
+    } else if (local >= strip->localHeight) {
+        memcpy(gray, strip->haloBottom + (size_t)(local - strip->localHeight) * strip->width, strip->width);
+    } else {
+        sobel_gray_row(strip->data + (size_t)local * strip->rowSize, gray, strip->width);
+    }
+}
+
+// Completar la histéresis entre franjas: en cada ronda los procesos vecinos
+// se intercambian sus filas de frontera ya clasificadas, cada uno promueve
+// los bordes débiles que tocan uno fuerte del vecino y los sigue dentro de
+// su franja. Termina cuando ningún proceso promueve nada. Devuelve el número
+// de rondas.
+int hysteresis_exchange(unsigned char *newdata, int width, int rowSize, int localHeight, int up, int down) {
+    unsigned char *above = (unsigned char *)malloc(2 * (size_t)rowSize);
+    if (above == NULL) {
+        fprintf(stderr, "Error al asignar memoria para las filas de frontera.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    unsigned char *below = above + rowSize;
+    unsigned char *last = newdata + (size_t)(localHeight - 1) * rowSize;
+    int rounds = 0, changed;
+
+    trace_begin("histeresis");
+    do {
+        MPI_Request requests[4];
+        MPI_Irecv(above, rowSize, MPI_UNSIGNED_CHAR, up, HALO_TAG_DOWN, MPI_COMM_WORLD, &requests[0]);
+        MPI_Irecv(below, rowSize, MPI_UNSIGNED_CHAR, down, HALO_TAG_UP, MPI_COMM_WORLD, &requests[1]);
+        MPI_Isend(newdata, rowSize, MPI_UNSIGNED_CHAR, up, HALO_TAG_UP, MPI_COMM_WORLD, &requests[2]);
+        MPI_Isend(last, rowSize, MPI_UNSIGNED_CHAR, down, HALO_TAG_DOWN, MPI_COMM_WORLD, &requests[3]);
+        MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+        rounds++;
+
+        long promoted = 0;
+        if (up != MPI_PROC_NULL) promoted += pipeline_grow_across(newdata, above, width);
+        if (down != MPI_PROC_NULL) promoted += pipeline_grow_across(last, below, width);
+        if (promoted > 0) {
+            pipeline_grow(newdata, width, rowSize, localHeight, 0, 1);
+            pipeline_grow(newdata, width, rowSize, localHeight, localHeight - 1, localHeight);
+        }
+
+        int local = (promoted > 0);
+        MPI_Allreduce(&local, &changed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    } while (changed);
+    trace_end();
 
-            int magnitude = (int)sqrt(gx * gx + gy * gy);
-            if (magnitude > 255) magnitude = 255;
-            unsigned char edgeVal = (unsigned char)magnitude;
+    free(above);
+    return rounds;
+}
 
-            int pos_rgb = y * rowSize + x * 3;
-            newdata[pos_rgb] = edgeVal;
-            newdata[pos_rgb + 1] = edgeVal;
-            newdata[pos_rgb + 2] = edgeVal;
+// Aplicar la cadena elegida con -f a una franja, como sobel_filter pero
+// intercambiando R filas en gris con cada vecino (R, el radio de la cadena).
+// Cada franja debe tener al menos R filas (classify_inputs envía las
+// imágenes más bajas al modo granja). Las filas que no dependen de los
+// vecinos se calculan mientras llegan las suyas. Con histéresis, cada
+// proceso sigue los bordes de su franja y después los de las fronteras con
+// hysteresis_exchange; el seguimiento local es secuencial, ya que su costo
+// es lineal en el número de bordes. Devuelve los bytes enviados a cada
+// vecino.
+long pipeline_filter(const unsigned char *data, unsigned char *newdata, int width, int height, int rowSize,
+                     int firstRow, int localHeight, int up, int down) {
+    int r = pipeline->radius;
+    size_t haloBytes = (size_t)r * width;
+    unsigned char *halos = (unsigned char *)malloc(4 * haloBytes);
+    if (halos == NULL) {
+        fprintf(stderr, "Error al asignar memoria para las filas fantasma.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    StripRows strip = { data, width, rowSize, firstRow, localHeight, r, halos, halos + haloBytes };
+    unsigned char *sendTop = halos + 2 * haloBytes;
+    unsigned char *sendBottom = halos + 3 * haloBytes;
+
+    // Convertir primero las filas de frontera para poder enviarlas cuanto antes
+    for (int i = 0; i < r; i++) {
+        if (up != MPI_PROC_NULL) {
+            sobel_gray_row(data + (size_t)i * rowSize, sendTop + (size_t)i * width, width);
+        }
+        if (down != MPI_PROC_NULL) {
+            sobel_gray_row(data + (size_t)(localHeight - r + i) * rowSize, sendBottom + (size_t)i * width, width);
         }
     }
-    free(grayData);
+
+    MPI_Request requests[4];
+    MPI_Irecv(halos, r * width, MPI_UNSIGNED_CHAR, up, HALO_TAG_DOWN, MPI_COMM_WORLD, &requests[0]);
+    MPI_Irecv(halos + haloBytes, r * width, MPI_UNSIGNED_CHAR, down, HALO_TAG_UP, MPI_COMM_WORLD, &requests[1]);
+    MPI_Isend(sendTop, r * width, MPI_UNSIGNED_CHAR, up, HALO_TAG_UP, MPI_COMM_WORLD, &requests[2]);
+    MPI_Isend(sendBottom, r * width, MPI_UNSIGNED_CHAR, down, HALO_TAG_DOWN, MPI_COMM_WORLD, &requests[3]);
+
+    // Filas locales que no necesitan las de los vecinos (en los bordes de la
+    // imagen las filas se replican y son propias)
+    int innerStart = (up == MPI_PROC_NULL) ? 0 : r;
+    int innerEnd = (down == MPI_PROC_NULL) ? localHeight : localHeight - r;
+    if (innerEnd < innerStart) innerEnd = innerStart;
+
+#ifdef _OPENMP
+    // Modo híbrido: el interior se reparte en bandas entre los hilos y el
+    // hilo maestro completa el intercambio mientras los demás calculan
+    int band = (HYBRID_BLOCK_ROWS > 4 * (2 * r + 1)) ? HYBRID_BLOCK_ROWS : 4 * (2 * r + 1);
+    int blocks = (innerEnd - innerStart + band - 1) / band;
+
+    #pragma omp parallel
+    {
+        PipelineWorker *worker = pipeline_worker_new(pipeline, width, height);
+
+        #pragma omp master
+        MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+
+        #pragma omp for schedule(dynamic) nowait
+        for (int b = 0; b < blocks; b++) {
+            int y0 = innerStart + b * band;
+            int y1 = (y0 + band < innerEnd) ? y0 + band : innerEnd;
+            pipeline_band(worker, load_strip_row, &strip, newdata + (size_t)y0 * rowSize, rowSize,
+                          firstRow + y0, firstRow + y1);
+        }
+
+        pipeline_worker_free(worker);
+    }
+    PipelineWorker *worker = pipeline_worker_new(pipeline, width, height);
+#else
+    PipelineWorker *worker = pipeline_worker_new(pipeline, width, height);
+    pipeline_band(worker, load_strip_row, &strip, newdata + (size_t)innerStart * rowSize, rowSize,
+                  firstRow + innerStart, firstRow + innerEnd);
+
+    MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+#endif
+
+    // Filas de frontera, que necesitan las filas de los vecinos
+    pipeline_band(worker, load_strip_row, &strip, newdata, rowSize, firstRow, firstRow + innerStart);
+    pipeline_band(worker, load_strip_row, &strip, newdata + (size_t)innerEnd * rowSize, rowSize,
+                  firstRow + innerEnd, firstRow + localHeight);
+
+    pipeline_worker_free(worker);
+    free(halos);
+
+    long sent = (long)r * width;
+    if (pipeline->hysteresis) {
+        pipeline_grow(newdata, width, rowSize, localHeight, 0, localHeight);
+        // Sin vecinos (modo granja o un solo proceso) no hay fronteras
+        if (up != MPI_PROC_NULL || down != MPI_PROC_NULL) {
+            sent += (long)hysteresis_exchange(newdata, width, rowSize, localHeight, up, down) * rowSize;
+        }
+        pipeline_finish(newdata, width, rowSize, localHeight);
+    }
+    return sent;
 }
 
-int main(int argc, char *argv[]) {
-    MPI_Init(&argc, &argv);
+// Estado de una imagen dentro del lote. Cada imagen pasa por tres etapas
+// (lectura, cómputo y escritura) y las tres se solapan entre imágenes
+// consecutivas: mientras se filtra la imagen N, la lectura anticipada de la
+// N + 1 y la escritura colectiva no bloqueante de la N - 1 están en curso.
+// La entrada se proyecta en memoria en cada proceso, de modo que los procesos
+// de un mismo nodo comparten la caché de páginas y leen su franja sin copias.
+typedef struct {
+    char input[PATH_MAX];
+    char output[PATH_MAX];
+    BMPImage image;
+    int width, height, rowSize;
+    int firstRow, localHeight;
+    size_t localSize;
+    MPI_Offset stripOffset;
+    MPI_File outputFile;
+    MPI_Datatype rowType;
+    MPI_Request writeRequest;
+    const unsigned char *subData;
+    unsigned char *subDataProcessed;
+
+    // Métricas: los mensajes (filas fantasma) se cuentan aparte de la E/S
+    long bytes_sent, bytes_received;
+    long bytes_read, bytes_written;
+    double comp_time, io_time;
+} ImageJob;
+
+// Número de imágenes en vuelo: una leyéndose, una filtrándose y una escribiéndose
+#define PIPELINE_DEPTH 3
+
+// Proyectar una imagen, validar sus encabezados y pedir al sistema la
+// lectura anticipada de la franja local (y sus filas vecinas). Devuelve 0 si
+// la imagen es válida; el resultado es el mismo en todos los procesos porque
+// todos validan el mismo archivo.
+int image_start_read(ImageJob *job, int rank, int size) {
+    double io_start = MPI_Wtime();
+    trace_begin("lectura");
+
+    job->bytes_sent = 0;
+    job->bytes_received = 0;
+    job->bytes_read = 0;
+    job->bytes_written = 0;
+    job->comp_time = 0;
+
+    int result = bmp_map(job->input, &job->image);
+    if (result != BMP_OK) {
+        if (rank == 0) {
+            fprintf(stderr, "Error abriendo el archivo de entrada %s: %s\n", job->input, bmp_strerror(result));
+        }
+        trace_end();
+        return -1;
+    }
 
-    int rank, size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    job->width = job->image.width;
+    job->height = job->image.height;
+    job->rowSize = job->image.rowSize;
+
+    // Cada proceso calcula su propia franja de filas, sin difusiones
+    int rows_per_process = job->height / size;
+    int remaining_rows = job->height % size;
+    job->localHeight = rows_per_process + (rank < remaining_rows ? 1 : 0);
+    job->firstRow = rank * rows_per_process + (rank < remaining_rows ? rank : remaining_rows);
+    job->localSize = (size_t)job->localHeight * job->rowSize;
+    job->stripOffset = job->image.header.offset + (MPI_Offset)job->firstRow * job->rowSize;
+
+    // Las filas se escriben como unidades de 'rowSize' bytes para que los
+    // conteos no desborden un int en imágenes grandes
+    MPI_Type_contiguous(job->rowSize, MPI_BYTE, &job->rowType);
+    MPI_Type_commit(&job->rowType);
+
+    // La franja se lee directamente de la proyección
+    job->subData = job->image.pixels + (size_t)job->firstRow * job->rowSize;
+    job->subDataProcessed = (unsigned char *)calloc(job->localSize, 1);
+    if (job->subDataProcessed == NULL && job->localSize > 0) {
+        fprintf(stderr, "No se pudo asignar memoria para los datos de la imagen.\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-    for (int img = 6; img <= 10; img++) {
-        BMPHeader bmpHeader;
-        BMPInfoHeader bmpInfoHeader;
-        unsigned char *data = NULL;
+    bmp_prefetch_rows(&job->image, job->firstRow, job->localHeight);
+    job->bytes_read += job->localSize;
 
-        int height, width, rowSize, totalSize;
-        int rows_per_process, remaining_rows;
-        int localHeight, localSize;
-        int *sendcounts = NULL;
-        int *displs = NULL;
+    trace_end();
+    job->io_time = MPI_Wtime() - io_start;
+    return 0;
+}
 
-        char input_filename[50];
-        sprintf(input_filename, "images/%d.bmp", img);
+// Aplicar el filtro Sobel a la franja local
+void image_compute(ImageJob *job, int rank, int size) {
+    // Procesos vecinos (las franjas vacías quedan siempre al final)
+    int up = (rank > 0) ? rank - 1 : MPI_PROC_NULL;
+    int down = (rank < size - 1 && rank + 1 < job->height) ? rank + 1 : MPI_PROC_NULL;
+
+    // Iniciar medición de tiempo de cómputo
+    double comp_start = MPI_Wtime();
+    trace_begin("sobel");
+
+    // Aplicar el filtro Sobel en cada proceso
+    if (job->localHeight > 0) {
+        long haloBytes = job->width;
+        if (pipeline != NULL) {
+            haloBytes = pipeline_filter(job->subData, job->subDataProcessed, job->width, job->height, job->rowSize,
+                                        job->firstRow, job->localHeight, up, down);
+        } else {
+            sobel_filter(job->subData, job->image.infoHeader, job->subDataProcessed,
+                         job->firstRow, job->localHeight, up, down);
+        }
 
-        if (rank == 0) {
-            FILE *inputFile = fopen(input_filename, "rb");
-            if (inputFile == NULL) {
-                perror("Error abriendo el archivo de entrada");
-                MPI_Abort(MPI_COMM_WORLD, 1);
-            }
+        int neighbours = (up != MPI_PROC_NULL) + (down != MPI_PROC_NULL);
+        job->bytes_sent += neighbours * haloBytes;
+        job->bytes_received += neighbours * haloBytes;
+    }
 
-            fread(&bmpHeader, sizeof(BMPHeader), 1, inputFile);
-            if (bmpHeader.type != 0x4D42) {
-                printf("El archivo no es un BMP válido\n");
-                fclose(inputFile);
-                MPI_Abort(MPI_COMM_WORLD, 1);
-            }
+    // Finalizar medición de tiempo de cómputo
+    trace_end();
+    job->comp_time = MPI_Wtime() - comp_start;
+}
 
-            fread(&bmpInfoHeader, sizeof(BMPInfoHeader), 1, inputFile);
+// Lanzar la escritura no bloqueante de la imagen procesada: el proceso 0
+// copia los encabezados de la entrada y cada proceso escribe su franja en su
+// posición. Después ya no se necesita la proyección de la entrada.
+void image_start_write(ImageJob *job, int rank) {
+    double io_start = MPI_Wtime();
+    trace_begin("escritura");
 
-            width = bmpInfoHeader.width;
-            height = abs(bmpInfoHeader.height);
-            rowSize = ((width * 3 + 3) & (~3)); // Alineación a 4 bytes
-            totalSize = rowSize * height;
+    if (MPI_File_open(MPI_COMM_WORLD, job->output, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &job->outputFile) != MPI_SUCCESS) {
+        if (rank == 0) {
+            printf("No se pudo crear el archivo de salida %s\n", job->output);
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(job->outputFile, job->image.header.offset + (MPI_Offset)job->image.dataSize);
 
-            data = (unsigned char *)malloc(totalSize);
-            if (data == NULL) {
-                fprintf(stderr, "No se pudo asignar memoria para los datos de la imagen.\n");
-                fclose(inputFile);
-                MPI_Abort(MPI_COMM_WORLD, 1);
-            }
+    if (rank == 0) {
+        MPI_File_write_at(job->outputFile, 0, job->image.map, job->image.header.offset, MPI_BYTE, MPI_STATUS_IGNORE);
+        job->bytes_written += job->image.header.offset;
+    }
 
-            fseek(inputFile, bmpHeader.offset, SEEK_SET);
-            fread(data, 1, totalSize, inputFile);
-            fclose(inputFile);
+    MPI_File_iwrite_at_all(job->outputFile, job->stripOffset, job->subDataProcessed, job->localHeight,
+                           job->rowType, &job->writeRequest);
+    job->bytes_written += job->localSize;
+    bmp_unmap(&job->image);
 
-            // Preparar los parámetros para la distribución de datos
-            rows_per_process = height / size;
-            remaining_rows = height % size;
+    trace_end();
+    job->io_time += MPI_Wtime() - io_start;
+}
 
-            sendcounts = (int *)malloc(size * sizeof(int));
-            displs = (int *)malloc(size * sizeof(int));
+// Esperar la escritura, liberar los recursos de la imagen y mostrar sus métricas
+void image_finish_write(ImageJob *job, int rank) {
+    double io_start = MPI_Wtime();
+    trace_begin("espera_escritura");
+    MPI_Wait(&job->writeRequest, MPI_STATUS_IGNORE);
+    MPI_File_close(&job->outputFile);
+    trace_end();
+    job->io_time += MPI_Wtime() - io_start;
+
+    // Obtener uso de recursos
+    struct rusage usage_stats;
+    getrusage(RUSAGE_SELF, &usage_stats);
+
+    // Mostrar métricas de cada proceso
+    printf(">>> Proceso [%d] Reporte de Métricas para imagen %s <<<\n", rank, job->input);
+    printf("Memoria Máxima Usada: %ld KB\n", usage_stats.ru_maxrss);
+    printf("Tiempo de Cómputo: %.6f segundos\n", job->comp_time);
+    printf("Tiempo de E/S: %.6f segundos\n", job->io_time);
+    printf("Datos Enviados: %ld bytes\n", job->bytes_sent);
+    printf("Datos Recibidos: %ld bytes\n", job->bytes_received);
+    printf("Datos Leídos: %ld bytes\n", job->bytes_read);
+    printf("Datos Escritos: %ld bytes\n", job->bytes_written);
+    printf("-------------------------------\n\n");
+
+    MPI_Type_free(&job->rowType);
+    free(job->subDataProcessed);
+}
 
-            int offset = 0;
-            for (int i = 0; i < size; i++) {
-                int lh = rows_per_process;
-                if (i < remaining_rows) {
-                    lh += 1;
-                }
-                sendcounts[i] = lh * rowSize;
-                displs[i] = offset;
-                offset += sendcounts[i];
-            }
-        }
+// Lista de imágenes común a todos los procesos: los nombres van seguidos,
+// cada uno terminado en NUL, y offsets[i] es el inicio del nombre i
+typedef struct {
+    int count;
+    char *names;
+    size_t *offsets;
+} InputList;
 
-        // Difundir los encabezados y parámetros
-        MPI_Bcast(&bmpHeader, sizeof(BMPHeader), MPI_BYTE, 0, MPI_COMM_WORLD);
-        MPI_Bcast(&bmpInfoHeader, sizeof(BMPInfoHeader), MPI_BYTE, 0, MPI_COMM_WORLD);
+static inline const char *input_name(const InputList *list, int i) {
+    return list->names + list->offsets[i];
+}
 
-        if (rank != 0) {
-            width = bmpInfoHeader.width;
-            height = abs(bmpInfoHeader.height);
-            rowSize = ((width * 3 + 3) & (~3));
-            totalSize = rowSize * height;
+// Construir en el proceso 0 la lista de imágenes a procesar y difundirla.
+// Cada argumento puede ser un archivo BMP o un directorio; sin argumentos se
+// procesan images/6.bmp ... images/10.bmp. Se difunden solo los bytes de los
+// nombres: primero el número de nombres y la longitud total, después el
+// bloque; cada proceso reconstruye los desplazamientos.
+void build_input_list(int argc, char *argv[], int rank, InputList *inputs) {
+    char **list = NULL;
+    long header[2] = { 0, 0 };   // número de nombres y bytes del bloque
 
-            rows_per_process = height / size;
-            remaining_rows = height % size;
+    if (rank == 0) {
+        int count;
+        list = bmp_list_inputs(argc, argv, 6, 10, &count);
+        header[0] = count;
+        for (int i = 0; i < count; i++) header[1] += strlen(list[i]) + 1;
+    }
+    MPI_Bcast(header, 2, MPI_LONG, 0, MPI_COMM_WORLD);
+    if (header[1] > INT_MAX) {
+        if (rank == 0) fprintf(stderr, "La lista de imágenes es demasiado grande\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
-            sendcounts = (int *)malloc(size * sizeof(int));
-            displs = (int *)malloc(size * sizeof(int));
+    inputs->count = (int)header[0];
+    inputs->names = malloc(header[1] + 1);
+    inputs->offsets = malloc((header[0] + 1) * sizeof(size_t));
+    if (inputs->names == NULL || inputs->offsets == NULL) {
+        fprintf(stderr, "Proceso %d: no se pudo asignar memoria para la lista de imágenes\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0) {
+        size_t length = 0;
+        for (int i = 0; i < inputs->count; i++) {
+            size_t bytes = strlen(list[i]) + 1;
+            memcpy(inputs->names + length, list[i], bytes);
+            length += bytes;
         }
+        bmp_free_list(list, inputs->count);
+    }
+    MPI_Bcast(inputs->names, (int)header[1], MPI_CHAR, 0, MPI_COMM_WORLD);
 
-        // Difundir 'sendcounts' y 'displs' a todos los procesos
-        MPI_Bcast(sendcounts, size, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(displs, size, MPI_INT, 0, MPI_COMM_WORLD);
+    size_t offset = 0;
+    for (int i = 0; i < inputs->count; i++) {
+        inputs->offsets[i] = offset;
+        offset += strlen(inputs->names + offset) + 1;
+    }
+}
 
-        localSize = sendcounts[rank];
-        localHeight = localSize / rowSize;
+// Modos de reparto del trabajo
+#define MODE_AUTO  0   // elegir por tamaño de imagen
+#define MODE_SPLIT 1   // cada imagen se reparte por filas entre todos los procesos
+#define MODE_FARM  2   // cada imagen la procesa completa un único proceso
+
+// Umbral por defecto (en píxeles) por debajo del cual una imagen se procesa
+// completa en un solo proceso en el modo automático
+#define FARM_THRESHOLD_PIXELS (1 << 20)
+
+// Decidir en el proceso 0 qué imágenes se procesan en modo granja y difundir
+// la decisión (1 = granja, 0 = reparto por filas). En el modo automático se
+// leen solo los encabezados; las imágenes ilegibles se dejan al reparto por
+// filas, que informa del error. Con una cadena de filtros, las imágenes
+// cuyas franjas tendrían menos filas que el radio de la cadena se procesan
+// siempre en modo granja.
+char *classify_inputs(const InputList *inputs, int mode, long threshold, int rank, int size) {
+    int count = inputs->count;
+    char *farm = calloc(count + 1, 1);
 
-        unsigned char *subData = (unsigned char *)malloc(localSize);
-        unsigned char *subDataProcessed = (unsigned char *)malloc(localSize);
+    if (rank == 0) {
+        for (int i = 0; i < count; i++) {
+            farm[i] = (mode == MODE_FARM);
+            if (mode != MODE_AUTO && pipeline == NULL) continue;
+
+            BMPHeader header;
+            BMPInfoHeader infoHeader;
+            if (bmp_read_header(input_name(inputs, i), &header, &infoHeader) == BMP_OK) {
+                if (mode == MODE_AUTO) {
+                    farm[i] = ((long)infoHeader.width * abs(infoHeader.height) < threshold);
+                }
+                if (pipeline != NULL && abs(infoHeader.height) / size < pipeline->radius) farm[i] = 1;
+            }
+        }
+    }
+
+    MPI_Bcast(farm, count, MPI_CHAR, 0, MPI_COMM_WORLD);
+    return farm;
+}
 
-        // Distribuir los datos a los procesos
-        MPI_Scatterv(data, sendcounts, displs, MPI_UNSIGNED_CHAR,
-                     subData, localSize, MPI_UNSIGNED_CHAR,
-                     0, MPI_COMM_WORLD);
+// Procesar una imagen completa en este proceso (modo granja). La entrada y
+// la salida se proyectan en memoria y el filtro escribe directamente en el
+// archivo de salida. Devuelve 0 si la imagen se procesó.
+int image_process_local(const char *input, const char *output, double *comp_time, double *io_time,
+                        long *bytes_io) {
+    double io_start = MPI_Wtime();
+
+    BMPImage source, target;
+    int result = bmp_map(input, &source);
+    if (result != BMP_OK) {
+        fprintf(stderr, "Error abriendo el archivo de entrada %s: %s\n", input, bmp_strerror(result));
+        return -1;
+    }
+    result = bmp_create(output, &source, &target);
+    if (result != BMP_OK) {
+        printf("No se pudo crear el archivo de salida %s: %s\n", output, bmp_strerror(result));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    *io_time += MPI_Wtime() - io_start;
+
+    // La imagen completa es una única franja sin vecinos
+    double comp_start = MPI_Wtime();
+    if (pipeline != NULL) {
+        pipeline_filter(source.pixels, target.pixels, source.width, source.height, source.rowSize,
+                        0, source.height, MPI_PROC_NULL, MPI_PROC_NULL);
+    } else {
+        sobel_filter(source.pixels, source.infoHeader, target.pixels, 0, source.height, MPI_PROC_NULL, MPI_PROC_NULL);
+    }
+    *comp_time += MPI_Wtime() - comp_start;
 
-        // Variables para métricas
-        struct rusage usage_stats;
-        long bytes_sent = 0;
-        long bytes_received = 0;
-        double comp_start, comp_end, comp_time;
-        double comm_start, comm_end, comm_time;
+    io_start = MPI_Wtime();
+    *bytes_io += 2 * (long)source.dataSize;
+    bmp_unmap(&target);
+    bmp_unmap(&source);
+    *io_time += MPI_Wtime() - io_start;
+    return 0;
+}
 
-        // Iniciar medición de tiempo de cómputo
-        comp_start = MPI_Wtime();
+// Modo granja: las imágenes 'indices[0 .. n)' se reparten dinámicamente. Un
+// contador compartido en una ventana RMA del proceso 0 indica la siguiente
+// imagen libre; cada proceso la reserva con MPI_Fetch_and_op en cuanto
+// termina la anterior, sin un proceso maestro dedicado.
+void run_farm(const InputList *inputs, const int *indices, int n, const char *outputDir, int rank) {
+    int *counter;
+    MPI_Win win;
+    MPI_Win_allocate(rank == 0 ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &counter, &win);
+    MPI_Win_lock_all(0, win);
+    if (rank == 0) {
+        *counter = 0;
+        MPI_Win_sync(win);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    trace_begin("granja");
+
+    int processed = 0;
+    double comp_time = 0, io_time = 0;
+    long bytes_io = 0;
+    const int one = 1;
+
+    while (1) {
+        int task;
+        MPI_Fetch_and_op(&one, &task, MPI_INT, 0, 0, MPI_SUM, win);
+        MPI_Win_flush(0, win);
+        if (task >= n) break;
+
+        char output[PATH_MAX];
+        const char *input = input_name(inputs, indices[task]);
+        bmp_output_name(input, outputDir, outputPrefix, output);
+        if (image_process_local(input, output, &comp_time, &io_time, &bytes_io) == 0) {
+            processed++;
+        }
+    }
 
-        int start = 0;
-        int end = localHeight;
+    trace_end();
+    MPI_Win_unlock_all(win);
+    MPI_Win_free(&win);
+
+    // Obtener uso de recursos
+    struct rusage usage_stats;
+    getrusage(RUSAGE_SELF, &usage_stats);
+
+    // Mostrar métricas de cada proceso
+    printf(">>> Proceso [%d] Reporte de Métricas en modo granja (%d imágenes) <<<\n", rank, processed);
+    printf("Memoria Máxima Usada: %ld KB\n", usage_stats.ru_maxrss);
+    printf("Tiempo de Cómputo: %.6f segundos\n", comp_time);
+    printf("Tiempo de E/S: %.6f segundos\n", io_time);
+    printf("Datos Leídos y Escritos: %ld bytes\n", bytes_io);
+    printf("-------------------------------\n\n");
+}
 
-        // Aplicar el filtro Sobel en cada proceso
-        sobel_filter(subData, bmpInfoHeader, subDataProcessed, start, end);
+// Reparto por filas: las imágenes 'indices[0 .. n)' se reparten entre todos
+// los procesos. En la iteración i se lanza la lectura de la imagen i + 1, se
+// filtra la imagen i, se lanza su escritura y se completa la escritura de la
+// imagen i - 1. Las imágenes inválidas se descartan.
+void run_pipeline(const InputList *inputs, const int *indices, int n, const char *outputDir, int rank, int size) {
+    ImageJob jobs[PIPELINE_DEPTH];
+    ImageJob *reading = NULL, *writing = NULL;
+    int slot = 0;
+    int next = 0;
+
+    while (next < n || reading != NULL || writing != NULL) {
+        // Lanzar la lectura de la siguiente imagen válida
+        ImageJob *computing = reading;
+        reading = NULL;
+        while (next < n && reading == NULL) {
+            ImageJob *job = &jobs[slot];
+            snprintf(job->input, PATH_MAX, "%s", input_name(inputs, indices[next++]));
+            bmp_output_name(job->input, outputDir, outputPrefix, job->output);
+            if (image_start_read(job, rank, size) == 0) {
+                reading = job;
+                slot = (slot + 1) % PIPELINE_DEPTH;
+            }
+        }
 
-        // Finalizar medición de tiempo de cómputo
-        comp_end = MPI_Wtime();
-        comp_time = comp_end - comp_start;
+        // La primera imagen no tiene otra con la que solaparse
+        if (computing == NULL && writing == NULL && reading != NULL) {
+            continue;
+        }
 
-        // Iniciar medición de tiempo de comunicación
-        comm_start = MPI_Wtime();
+        if (computing != NULL) {
+            image_compute(computing, rank, size);
+            image_start_write(computing, rank);
+        }
 
-        // Recopilar los datos procesados en el proceso 0
-        unsigned char *newData = NULL;
-        if (rank == 0) {
-            newData = (unsigned char *)malloc(totalSize);
+        if (writing != NULL) {
+            image_finish_write(writing, rank);
         }
+        writing = computing;
+    }
+}
 
-        MPI_Gatherv(subDataProcessed, localSize, MPI_UNSIGNED_CHAR,
-                    newData, sendcounts, displs, MPI_UNSIGNED_CHAR,
-                    0, MPI_COMM_WORLD);
+// Mostrar la forma de uso y terminar
+void usage(const char *program, int rank) {
+    if (rank == 0) {
+        fprintf(stderr, "Uso: %s [-o directorio_salida] [-m auto|split|farm] [-p umbral_píxeles] "
+                        "[-r repeticiones] [-f filtro] [imagen.bmp | directorio]...\n", program);
+    }
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
 
-        // Actualizar métricas de comunicación
-        bytes_sent += localSize;
-        bytes_received += localSize;
+int main(int argc, char *argv[]) {
+    // Solo el hilo maestro de cada proceso realiza llamadas MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
-        // Finalizar medición de tiempo de comunicación
-        comm_end = MPI_Wtime();
-        comm_time = comm_end - comm_start;
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-        // Obtener uso de recursos
-        getrusage(RUSAGE_SELF, &usage_stats);
+    // Opciones: -o DIRECTORIO para las salidas, -m auto|split|farm para el
+    // reparto, -p PÍXELES para el umbral del modo automático, -r para
+    // repetir el lote completo y -f para elegir otro filtro o una cadena de
+    // filtros (pipeline.h); el resto de argumentos son imágenes o
+    // directorios de imágenes
+    const char *outputDir = NULL;
+    int mode = MODE_AUTO;
+    long threshold = FARM_THRESHOLD_PIXELS;
+    int repetitions = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:m:p:r:f:")) != -1) {
+        switch (opt) {
+            case 'o': outputDir = optarg; break;
+            case 'm':
+                if (strcmp(optarg, "auto") == 0) mode = MODE_AUTO;
+                else if (strcmp(optarg, "split") == 0) mode = MODE_SPLIT;
+                else if (strcmp(optarg, "farm") == 0) mode = MODE_FARM;
+                else usage(argv[0], rank);
+                break;
+            case 'p': threshold = atol(optarg); break;
+            case 'r':
+                repetitions = atoi(optarg);
+                if (repetitions < 1) usage(argv[0], rank);
+                break;
+            case 'f':
+                if (pipeline_parse(optarg, &selectedPipeline) != 0) usage(argv[0], rank);
+                pipeline = &selectedPipeline;
+                snprintf(outputPrefix, sizeof(outputPrefix), "sobel_mpi_%.48s_", pipeline->name);
+                break;
+            default: usage(argv[0], rank);
+        }
+    }
 
-        // Mostrar métricas de cada proceso
-        printf(">>> Proceso [%d] Reporte de Métricas para imagen %d <<<\n", rank, img);
-        printf("Memoria Máxima Usada: %ld KB\n", usage_stats.ru_maxrss);
-        printf("Tiempo de Cómputo: %.6f segundos\n", comp_time);
-        printf("Tiempo de Comunicación: %.6f segundos\n", comm_time);
-        printf("Datos Enviados: %ld bytes\n", bytes_sent);
-        printf("Datos Recibidos: %ld bytes\n", bytes_received);
-        printf("-------------------------------\n\n");
+    const char *kernelName;
+    sobel_mag = sobel_mag_select(&kernelName);
+    if (rank == 0) {
+        if (pipeline != NULL) {
+            char stages[256];
+            pipeline_describe(pipeline, stages, sizeof(stages));
+            printf("Filtro: %s (radio %d: %s)\n", pipeline->name, pipeline->radius, stages);
+        } else {
+            printf("Núcleo Sobel: %s\n", kernelName);
+        }
+#ifdef _OPENMP
+        printf("Modo híbrido MPI+OpenMP: %d procesos x %d hilos\n", size, omp_get_max_threads());
+        if (provided < MPI_THREAD_FUNNELED) {
+            printf("Aviso: la biblioteca MPI no garantiza MPI_THREAD_FUNNELED\n");
+        }
+#endif
+    }
 
-        if (rank == 0) {
-            // Guardar la imagen procesada
-            char output_filename[50];
-            sprintf(output_filename, "images/sobel_mpi_%d.bmp", img);
-            FILE *outputFile = fopen(output_filename, "wb");
-            if (!outputFile) {
-                printf("No se pudo crear el archivo de salida\n");
-                MPI_Abort(MPI_COMM_WORLD, 1);
-            }
+    InputList inputs;
+    trace_begin("preparacion");
+    build_input_list(argc - optind, argv + optind, rank, &inputs);
+    int count = inputs.count;
+    char *farm = classify_inputs(&inputs, mode, threshold, rank, size);
+    trace_end();
+
+    int *farmIndices = malloc((count + 1) * sizeof(int));
+    int *splitIndices = malloc((count + 1) * sizeof(int));
+    int farmCount = 0, splitCount = 0;
+    for (int i = 0; i < count; i++) {
+        if (farm[i]) farmIndices[farmCount++] = i;
+        else splitIndices[splitCount++] = i;
+    }
+    if (rank == 0) {
+        printf("Imágenes: %d en modo granja, %d repartidas por filas\n", farmCount, splitCount);
+    }
 
-            fwrite(&bmpHeader, sizeof(BMPHeader), 1, outputFile);
-            fwrite(&bmpInfoHeader, sizeof(BMPInfoHeader), 1, outputFile);
-            fseek(outputFile, bmpHeader.offset, SEEK_SET);
-            fwrite(newData, 1, totalSize, outputFile);
+    double *samples = malloc(repetitions * sizeof(double));
+    for (int rep = 1; rep <= repetitions; rep++) {
+        if (rank == 0 && repetitions > 1) {
+            printf("=== Repetición %d de %d ===\n", rep, repetitions);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        double batch_start = MPI_Wtime();
 
-            fclose(outputFile);
-            free(newData);
-            free(data);
-            free(sendcounts);
-            free(displs);
+        if (farmCount > 0) {
+            run_farm(&inputs, farmIndices, farmCount, outputDir, rank);
+        }
+        if (splitCount > 0) {
+            run_pipeline(&inputs, splitIndices, splitCount, outputDir, rank, size);
         }
 
-        free(subData);
-        free(subDataProcessed);
+        MPI_Barrier(MPI_COMM_WORLD);
+        samples[rep - 1] = MPI_Wtime() - batch_start;
+        if (rank == 0) {
+            printf("Tiempo Total del Lote: %.6f segundos\n", samples[rep - 1]);
+        }
     }
 
     if (rank == 0) {
+        // Píxeles del lote: cada repetición lee y escribe todas las imágenes
+        double pixels = 0.0, bytes = 0.0;
+        for (int i = 0; i < count; i++) {
+            BMPHeader header;
+            BMPInfoHeader infoHeader;
+            if (bmp_read_header(input_name(&inputs, i), &header, &infoHeader) == BMP_OK) {
+                int height = abs(infoHeader.height);
+                pixels += (double)infoHeader.width * height;
+                bytes += 2.0 * bmp_row_size(infoHeader.width) * height;
+            }
+        }
+        static const char *modeNames[] = { "auto", "split", "farm" };
+        char config[96];
+        snprintf(config, sizeof(config), "%d imágenes %s", count, pipeline ? pipeline->name : kernelName);
+        int threads = 1;
+#ifdef _OPENMP
+        threads = omp_get_max_threads();
+#endif
+        BenchInfo info = { "sobel_mpi", modeNames[mode], config, size, threads, pixels, bytes, "GB/s" };
+        bench_report(&info, samples, repetitions);
+    }
+    free(samples);
+
+    free(farmIndices);
+    free(splitIndices);
+    free(farm);
+    free(inputs.names);
+    free(inputs.offsets);
+
+    // Esperar a que el usuario presione Enter solo en ejecuciones
+    // interactivas, para no bloquear trabajos por lotes
+    if (rank == 0 && argc == 1 && isatty(STDIN_FILENO)) {
         printf("Presione Enter para finalizar...");
         getchar();
     }
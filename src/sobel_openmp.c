@@ -1,127 +1,582 @@
 // sobel_openmp.c
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
 #include <omp.h>
+#include "bmp_io.h"
+#include "sobel_simd.h"
+#include "pipeline.h"
+#include "bench.h"
 
-// Estructuras para manejar el encabezado BMP
-#pragma pack(push, 1)
-typedef struct {
-    unsigned short type;
-    unsigned int size;
-    unsigned short reserved1;
-    unsigned short reserved2;
-    unsigned int offset;
-} BMPHeader;
 
-typedef struct {
-    unsigned int size;
-    int width;
-    int height;
-    unsigned short planes;
-    unsigned short bitCount;
-    unsigned int compression;
-    unsigned int imageSize;
-    int xPixelsPerMeter;
-    int yPixelsPerMeter;
-    unsigned int colorsUsed;
-    unsigned int colorsImportant;
-} BMPInfoHeader;
-#pragma pack(pop)
-
-// Función para aplicar el filtro Sobel con OpenMP
-void sobel_filter_omp(unsigned char *data, unsigned char *output, int width, int height) {
-    int Gx[3][3] = { {-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1} };
-    int Gy[3][3] = { {-1, -2, -1}, {0, 0, 0}, {1, 2, 1} };
-
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-    unsigned char *grayData = malloc(width * height);
-
-    // Convertir a escala de grises
-    #pragma omp parallel for
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int pos = y * rowSize + x * 3;
-            unsigned char gray = (data[pos] + data[pos + 1] + data[pos + 2]) / 3;
-            grayData[y * width + x] = gray;
+// Píxeles por bloque al calcular la magnitud de una fila
+#define SOBEL_CHUNK 256
+
+// Núcleo de magnitud Sobel elegido en tiempo de ejecución
+static sobel_mag_fn sobel_mag;
+
+// Cadena de filtros elegida con -f (NULL: Sobel clásico)
+static Pipeline *pipeline;
+static Pipeline selectedPipeline;
+
+// Tamaño por defecto de los bloques 2D: unas 1024 x 32 píxeles ocupan cerca
+// de 200 KB entre entrada y salida, lo que cabe en una caché L2 típica
+static int tileWidth = 1024;
+static int tileHeight = 32;
+
+// Modo NUMA (-n o SOBEL_NUMA=1): carga en paralelo con primer contacto y
+// bandas de filas estáticas por hilo
+static int numaMode = 0;
+
+// Modo por bandas (-b FILAS o SOBEL_STREAM=FILAS; 0: imagen proyectada
+// completa) y búferes del lector: la banda en uso y dos leídas por adelantado
+static int streamRows = 0;
+#define STREAM_DEPTH 3
+
+// Directorio de salida (-o; por defecto el de cada entrada) y repeticiones
+// del filtro sobre cada imagen (-r)
+static const char *outputDir = NULL;
+static int repetitions = 1;
+
+// Aplicar el filtro Sobel a 'n' píxeles de la fila 'cur' usando sus filas
+// vecinas en gris; los punteros apuntan al primer píxel a calcular.
+// La magnitud se calcula por bloques con el núcleo seleccionado para la CPU
+// y luego se replica en los tres canales de la fila de salida.
+void sobel_row(const unsigned char *prev, const unsigned char *cur, const unsigned char *next,
+               unsigned char *out, int n) {
+    unsigned char mag[SOBEL_CHUNK];
+
+    for (int x = 0; x < n; x += SOBEL_CHUNK) {
+        int len = (n - x < SOBEL_CHUNK) ? n - x : SOBEL_CHUNK;
+        sobel_mag(prev + x, cur + x, next + x, mag, len);
+
+        for (int i = 0; i < len; i++) {
+            int pos = (x + i) * 3;
+            out[pos] = mag[i];
+            out[pos + 1] = mag[i];
+            out[pos + 2] = mag[i];
+        }
+    }
+}
+
+// Aplicar el filtro Sobel al bloque de salida [x0, x1) x [y0, y1) en una sola
+// pasada. Las filas del bloque (más una columna y una fila de borde a cada
+// lado) se convierten a gris bajo demanda en el búfer circular 'lines' de
+// tres filas de (x1 - x0 + 2) píxeles.
+void sobel_tile(const unsigned char *data, unsigned char *output, unsigned char *lines,
+                int rowSize, int x0, int x1, int y0, int y1) {
+    int n = x1 - x0;
+    int stride = n + 2;
+    const unsigned char *src = data + (x0 - 1) * 3;
+
+    sobel_gray_row(src + (size_t)(y0 - 1) * rowSize, lines + ((y0 - 1) % 3) * stride, stride);
+    sobel_gray_row(src + (size_t)y0 * rowSize, lines + (y0 % 3) * stride, stride);
+
+    for (int y = y0; y < y1; y++) {
+        sobel_gray_row(src + (size_t)(y + 1) * rowSize, lines + ((y + 1) % 3) * stride, stride);
+        sobel_row(lines + ((y - 1) % 3) * stride + 1, lines + (y % 3) * stride + 1,
+                  lines + ((y + 1) % 3) * stride + 1, output + (size_t)y * rowSize + x0 * 3, n);
+    }
+}
+
+// Reparto estático de 'rows' filas entre hilos: el hilo 'tid' recibe [*start, *end)
+void thread_rows(int rows, int tid, int nthreads, int *start, int *end) {
+    *start = (int)((long)rows * tid / nthreads);
+    *end = (int)((long)rows * (tid + 1) / nthreads);
+}
+
+// Cargar los píxeles en modo NUMA: cada hilo lee con pread su banda de filas
+// y pone a cero la misma banda de la salida, de modo que las páginas de ambos
+// búferes se asignan en el nodo NUMA del hilo que luego las procesa
+// (política de primer contacto). Devuelve 0 si todas las lecturas se completan.
+int load_rows_first_touch(int fd, off_t offset, unsigned char *data, unsigned char *output,
+                          int rowSize, int height) {
+    int failed = 0;
+
+    #pragma omp parallel reduction(|:failed)
+    {
+        int start, end;
+        thread_rows(height, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+
+        size_t first = (size_t)start * rowSize;
+        size_t bytes = (size_t)(end - start) * rowSize;
+        memset(output + first, 0, bytes);
+
+        size_t done = 0;
+        while (done < bytes) {
+            ssize_t n = pread(fd, data + first + done, bytes - done, offset + first + done);
+            if (n <= 0) {
+                failed = 1;
+                break;
+            }
+            done += n;
         }
     }
 
-    // Aplicar el filtro Sobel
-    #pragma omp parallel for
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            int gx = 0, gy = 0;
-            for (int i = -1; i <= 1; i++) {
-                for (int j = -1; j <= 1; j++) {
-                    int pixel = grayData[(y + i) * width + (x + j)];
-                    gx += Gx[i + 1][j + 1] * pixel;
-                    gy += Gy[i + 1][j + 1] * pixel;
+    return failed ? -1 : 0;
+}
+
+// Función para aplicar el filtro Sobel con OpenMP.
+// La imagen se divide en bloques 2D de tileWidth x tileHeight píxeles que se
+// reparten entre los hilos de una única región paralela según la
+// planificación en tiempo de ejecución (OMP_SCHEDULE u opción -s). Cada
+// hilo reutiliza su propio búfer de tres filas para todos sus bloques.
+// 'data' y 'output' tienen filas de 'rowSize' bytes (pueden apuntar
+// directamente a imágenes proyectadas en memoria).
+void sobel_filter_omp(const unsigned char *data, unsigned char *output, int width, int height, int rowSize) {
+    if (width < 3 || height < 3) return;
+
+    int tw = (tileWidth < width - 2) ? tileWidth : width - 2;
+    int th = (tileHeight < height - 2) ? tileHeight : height - 2;
+    int tilesX = (width - 2 + tw - 1) / tw;
+    int tilesY = (height - 2 + th - 1) / th;
+
+    // Modo NUMA: cada hilo procesa su banda estática de filas, la misma que
+    // tocó primero al cargar la imagen, para trabajar con memoria local
+    if (numaMode) {
+        #pragma omp parallel
+        {
+            unsigned char *lines = malloc(3 * (tw + 2));
+            int start, end;
+            thread_rows(height, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+            if (start < 1) start = 1;
+            if (end > height - 1) end = height - 1;
+
+            for (int y0 = start; y0 < end; y0 += th) {
+                int y1 = (y0 + th < end) ? y0 + th : end;
+                for (int x0 = 1; x0 < width - 1; x0 += tw) {
+                    int x1 = (x0 + tw < width - 1) ? x0 + tw : width - 1;
+                    sobel_tile(data, output, lines, rowSize, x0, x1, y0, y1);
                 }
             }
-            int magnitude = (int)sqrt(gx * gx + gy * gy);
-            if (magnitude > 255) magnitude = 255;
-            int pos = y * rowSize + x * 3;
-            output[pos] = magnitude;
-            output[pos + 1] = magnitude;
-            output[pos + 2] = magnitude;
+
+            free(lines);
+        }
+        return;
+    }
+
+    #pragma omp parallel
+    {
+        unsigned char *lines = malloc(3 * (tw + 2));
+
+        #pragma omp for schedule(runtime) collapse(2)
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                int x0 = 1 + tx * tw;
+                int y0 = 1 + ty * th;
+                int x1 = (x0 + tw < width - 1) ? x0 + tw : width - 1;
+                int y1 = (y0 + th < height - 1) ? y0 + th : height - 1;
+                sobel_tile(data, output, lines, rowSize, x0, x1, y0, y1);
+            }
+        }
+
+        free(lines);
+    }
+}
+
+// Filas de la entrada para la cadena de filtros; 'data' es la fila 'first'
+typedef struct {
+    const unsigned char *data;
+    int first, width, rowSize;
+} GrayRows;
+
+void load_gray_row(void *ctx, int y, unsigned char *gray) {
+    const GrayRows *rows = ctx;
+    sobel_gray_row(rows->data + (size_t)(y - rows->first) * rows->rowSize, gray, rows->width);
+}
+
+// Filas por banda de la cadena con OpenMP: tileHeight y al menos 4 (2R + 1)
+int pipeline_band_rows(void) {
+    int size = 2 * pipeline->radius + 1;
+    return (tileHeight > 4 * size) ? tileHeight : 4 * size;
+}
+
+// Aplicar la cadena elegida con -f con OpenMP a las filas [y0, y1) de una
+// imagen de 'height' filas ('output' apunta a la fila y0), repartiendo bandas
+// de filas según la planificación en tiempo de ejecución. Cada banda vuelve
+// a cargar 2R filas de borde (R, el radio de la cadena). Cada hilo reutiliza
+// su estado de trabajo (búferes circulares de cada etapa) para todas sus
+// bandas.
+//
+// La histéresis se resuelve en tres pasos: cada banda sigue sus propios
+// bordes junto con el filtro; después un solo hilo propaga los bordes
+// fuertes de las filas de frontera entre bandas (un camino que cruza de una
+// banda a otra ya es fuerte al llegar a su primera frontera) y por último
+// pipeline_finish_omp descarta los bordes débiles que quedan, una vez
+// calculadas todas las filas.
+void pipeline_rows_omp(const GrayRows *rows, unsigned char *output, int height, int y0, int y1) {
+    int width = rows->width, rowSize = rows->rowSize;
+    int band = pipeline_band_rows();
+    int bands = (y1 - y0 + band - 1) / band;
+    int threads = 1;
+
+    #pragma omp parallel
+    {
+        PipelineWorker *worker = pipeline_worker_new(pipeline, width, height);
+
+        if (numaMode) {
+            // Misma banda estática de filas que tocó primero cada hilo
+            int start, end;
+            thread_rows(y1 - y0, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+            if (omp_get_thread_num() == 0) threads = omp_get_num_threads();
+            pipeline_band(worker, load_gray_row, (void *)rows, output + (size_t)start * rowSize, rowSize,
+                          y0 + start, y0 + end);
+            if (pipeline->hysteresis) {
+                pipeline_grow(output + (size_t)start * rowSize, width, rowSize, end - start, 0, end - start);
+            }
+        } else {
+            #pragma omp for schedule(runtime)
+            for (int b = 0; b < bands; b++) {
+                int start = b * band;
+                int end = (start + band < y1 - y0) ? start + band : y1 - y0;
+                pipeline_band(worker, load_gray_row, (void *)rows, output + (size_t)start * rowSize, rowSize,
+                              y0 + start, y0 + end);
+                if (pipeline->hysteresis) {
+                    pipeline_grow(output + (size_t)start * rowSize, width, rowSize, end - start, 0, end - start);
+                }
+            }
+        }
+
+        pipeline_worker_free(worker);
+    }
+
+    if (!pipeline->hysteresis) return;
+
+    if (numaMode) bands = threads;
+    for (int b = 1; b < bands; b++) {
+        int start = b * band, end;
+        if (numaMode) thread_rows(y1 - y0, b, threads, &start, &end);
+        pipeline_grow(output, width, rowSize, y1 - y0, start - 1, start + 1);
+    }
+}
+
+// Último paso de la histéresis: descartar en paralelo los bordes débiles
+void pipeline_finish_omp(unsigned char *output, int width, int height, int rowSize) {
+    int band = pipeline_band_rows();
+    int bands = (height + band - 1) / band;
+
+    #pragma omp parallel
+    {
+        if (numaMode) {
+            int start, end;
+            thread_rows(height, omp_get_thread_num(), omp_get_num_threads(), &start, &end);
+            pipeline_finish(output + (size_t)start * rowSize, width, rowSize, end - start);
+        } else {
+            #pragma omp for schedule(runtime)
+            for (int b = 0; b < bands; b++) {
+                int y0 = b * band;
+                int y1 = (y0 + band < height) ? y0 + band : height;
+                pipeline_finish(output + (size_t)y0 * rowSize, width, rowSize, y1 - y0);
+            }
+        }
+    }
+}
+
+// Aplicar la cadena elegida con -f con OpenMP a la imagen completa
+void pipeline_filter_omp(const unsigned char *data, unsigned char *output, int width, int height, int rowSize) {
+    GrayRows rows = { data, 0, width, rowSize };
+
+    pipeline_rows_omp(&rows, output, height, 0, height);
+    if (pipeline->hysteresis) pipeline_finish_omp(output, width, height, rowSize);
+}
+
+// Aplicar el filtro elegido: el Sobel clásico o la cadena de filtros
+void apply_filter(const unsigned char *data, unsigned char *output, int width, int height, int rowSize) {
+    if (pipeline != NULL) pipeline_filter_omp(data, output, width, height, rowSize);
+    else sobel_filter_omp(data, output, width, height, rowSize);
+}
+
+// Calcular las filas de salida [lo, hi) a partir de una ventana de la
+// entrada que empieza en la fila 'first' de la imagen y contiene todas las
+// filas vecinas que necesitan. 'out' apunta a la fila lo y va precedido de
+// una fila libre, que el Sobel clásico usa como borde sin escribirla.
+void filter_window(const unsigned char *window, int first, unsigned char *out,
+                   int width, int height, int rowSize, int lo, int hi) {
+    if (pipeline != NULL) {
+        GrayRows rows = { window, first, width, rowSize };
+        pipeline_rows_omp(&rows, out, height, lo, hi);
+        return;
+    }
+
+    // Las filas de borde de la imagen quedan a cero, como en bmp_create
+    if (lo == 0) memset(out, 0, rowSize);
+    if (hi == height) memset(out + (size_t)(height - 1 - lo) * rowSize, 0, rowSize);
+    int start = (lo > 1) ? lo : 1;
+    int end = (hi < height - 1) ? hi : height - 1;
+    if (start < end) {
+        sobel_filter_omp(window + (size_t)(start - 1 - first) * rowSize, out + (size_t)(start - 1 - lo) * rowSize,
+                         width, end - start + 2, rowSize);
+    }
+}
+
+// Modo por bandas: la entrada se lee por bandas de streamRows filas con
+// lectura anticipada en un hilo aparte (bmp_reader_open) mientras los hilos
+// OpenMP calculan la banda anterior, y cada banda de salida se escribe en el
+// archivo en cuanto está calculada, de modo que la memoria usada depende del
+// tamaño de banda y no del alto de la imagen. Cada banda trae 2R filas de la
+// anterior (R: radio del filtro) y la salida se calcula con R filas de
+// retraso respecto a la entrada leída. Con histéresis, los bordes que cruzan
+// de una banda a otra y el descarte de los débiles se resuelven al final
+// sobre la proyección de la salida.
+int stream_filter(const BMPImage *input, BMPImage *output) {
+    int width = input->width, height = input->height, rowSize = input->rowSize;
+    int radius = pipeline ? pipeline->radius : 1;
+    int band = (streamRows > 2 * radius) ? streamRows : 2 * radius;
+
+    BMPReader *reader = bmp_reader_open(input, band, 2 * radius, STREAM_DEPTH);
+    unsigned char *buffer = calloc((size_t)band + radius + 1, rowSize);
+    if (reader == NULL || buffer == NULL) {
+        if (reader != NULL) bmp_reader_close(reader);
+        free(buffer);
+        return BMP_ERR_IO;
+    }
+
+    const unsigned char *window;
+    int first, rows, result = BMP_OK;
+    while (result == BMP_OK && (window = bmp_reader_next(reader, &first, &rows)) != NULL) {
+        int lo = (first == 0) ? 0 : first + radius;
+        int hi = (first + rows == height) ? height : first + rows - radius;
+        filter_window(window, first, buffer + rowSize, width, height, rowSize, lo, hi);
+        result = bmp_write_rows(output, lo, hi - lo, buffer + rowSize);
+    }
+    if (bmp_reader_close(reader) != BMP_OK) result = BMP_ERR_IO;
+
+    if (result == BMP_OK && pipeline != NULL && pipeline->hysteresis) {
+        for (int y = band - radius; y + radius < height; y += band) {
+            pipeline_grow(output->pixels, width, rowSize, height, y - 1, y + 1);
         }
+        pipeline_finish_omp(output->pixels, width, height, rowSize);
     }
 
-    free(grayData);
+    free(buffer);
+    return result;
 }
 
-int main() {
-    BMPHeader header;
-    BMPInfoHeader infoHeader;
-    unsigned char *data, *output;
-    char input_filename[50];
-    char output_filename[50];
+// Memoria del modo por bandas: búferes del lector y de la banda de salida
+size_t stream_bytes(int rowSize) {
+    int radius = pipeline ? pipeline->radius : 1;
+    int band = (streamRows > 2 * radius) ? streamRows : 2 * radius;
+    return ((size_t)STREAM_DEPTH * (band + 2 * radius) + band + radius + 1) * rowSize;
+}
+
+// Leer la configuración de bloques, planificación, hilos, salida y
+// repeticiones. Las opciones de línea de comandos tienen prioridad sobre las
+// variables de entorno SOBEL_TILE ("ANCHOxALTO"), SOBEL_STREAM, OMP_SCHEDULE
+// y OMP_NUM_THREADS. Los argumentos restantes (desde optind) son imágenes o
+// directorios.
+void parse_options(int argc, char *argv[]) {
+    const char *tile = getenv("SOBEL_TILE");
+    const char *schedule = NULL;
+    const char *numa = getenv("SOBEL_NUMA");
+    const char *stream = getenv("SOBEL_STREAM");
+    int opt;
+
+    if (numa != NULL && strcmp(numa, "0") != 0) numaMode = 1;
+    if (stream != NULL && atoi(stream) > 0) streamRows = atoi(stream);
+
+    while ((opt = getopt(argc, argv, "t:s:np:o:r:f:b:")) != -1) {
+        int valid = 1, threads;
+        switch (opt) {
+            case 't': tile = optarg; break;
+            case 's': schedule = optarg; break;
+            case 'n': numaMode = 1; break;
+            case 'p':
+                threads = atoi(optarg);
+                valid = (threads > 0);
+                if (valid) omp_set_num_threads(threads);
+                break;
+            case 'o': outputDir = optarg; break;
+            case 'r': repetitions = atoi(optarg); valid = (repetitions > 0); break;
+            case 'f':
+                valid = (pipeline_parse(optarg, &selectedPipeline) == 0);
+                pipeline = &selectedPipeline;
+                break;
+            case 'b': streamRows = atoi(optarg); valid = (streamRows > 0); break;
+            default: valid = 0;
+        }
+        if (!valid) {
+            fprintf(stderr, "Uso: %s [-t ANCHOxALTO] [-s static|dynamic|guided|auto[,bloque]] [-n] [-p hilos] "
+                            "[-o directorio_salida] [-r repeticiones] [-f filtro] [-b filas] "
+                            "[imagen.bmp | directorio]...\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
 
-    for (int img = 1; img <= 5; img++) {
-        sprintf(input_filename, "images/%d.bmp", img);
-        FILE *file = fopen(input_filename, "rb");
-        if (!file) {
-            printf("No se pudo abrir la imagen %s\n", input_filename);
+    // El modo NUMA carga la imagen completa: no se combina con las bandas
+    if (numaMode && streamRows > 0) {
+        fprintf(stderr, "El modo NUMA (-n) y el modo por bandas (-b) no se pueden combinar\n");
+        exit(1);
+    }
+
+    if (tile != NULL) {
+        int w, h;
+        if (sscanf(tile, "%dx%d", &w, &h) != 2 || w < 1 || h < 1) {
+            fprintf(stderr, "Tamaño de bloque inválido: %s\n", tile);
+            exit(1);
+        }
+        tileWidth = w;
+        tileHeight = h;
+    }
+
+    if (schedule == NULL) {
+        schedule = getenv("OMP_SCHEDULE");
+        // Sin OMP_SCHEDULE, usar una planificación estática por defecto
+        if (schedule == NULL) schedule = "static";
+    }
+
+    char kind[16] = "";
+    int chunk = 0;
+    sscanf(schedule, "%15[a-z],%d", kind, &chunk);
+    if (strcmp(kind, "static") == 0) omp_set_schedule(omp_sched_static, chunk);
+    else if (strcmp(kind, "dynamic") == 0) omp_set_schedule(omp_sched_dynamic, chunk);
+    else if (strcmp(kind, "guided") == 0) omp_set_schedule(omp_sched_guided, chunk);
+    else if (strcmp(kind, "auto") == 0) omp_set_schedule(omp_sched_auto, chunk);
+    else {
+        fprintf(stderr, "Planificación inválida: %s\n", schedule);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    BMPImage input, output;
+    char output_filename[PATH_MAX];
+
+    parse_options(argc, argv);
+
+    const char *kernelName;
+    sobel_mag = sobel_mag_select(&kernelName);
+    char outputPrefix[64] = "sobel_openmp_";
+    if (pipeline != NULL) {
+        char stages[256];
+        pipeline_describe(pipeline, stages, sizeof(stages));
+        kernelName = pipeline->name;
+        snprintf(outputPrefix, sizeof(outputPrefix), "sobel_openmp_%.48s_", pipeline->name);
+        printf("Filtro: %s (radio %d: %s), %d hilos\n", pipeline->name, pipeline->radius, stages,
+               omp_get_max_threads());
+    } else {
+        printf("Núcleo Sobel: %s, bloques de %dx%d píxeles, %d hilos\n",
+               kernelName, tileWidth, tileHeight, omp_get_max_threads());
+    }
+    if (numaMode) {
+        printf("Modo NUMA: carga con primer contacto y bandas de filas por hilo\n");
+        if (omp_get_proc_bind() == omp_proc_bind_false) {
+            printf("Aviso: sin OMP_PROC_BIND los hilos pueden migrar entre nodos NUMA\n");
+        }
+    }
+    if (streamRows > 0) {
+        printf("Modo por bandas: %d filas por banda, %d bandas leídas por adelantado\n",
+               streamRows, STREAM_DEPTH - 1);
+    }
+
+    int count;
+    char **inputs = bmp_list_inputs(argc - optind, argv + optind, 1, 5, &count);
+    double *samples = malloc(repetitions * sizeof(double));
+
+    for (int img = 0; img < count; img++) {
+        const char *input_filename = inputs[img];
+        int result = bmp_map(input_filename, &input);
+        if (result != BMP_OK) {
+            printf("No se pudo abrir la imagen %s: %s\n", input_filename, bmp_strerror(result));
             continue;
         }
+        bmp_output_name(input_filename, outputDir, outputPrefix, output_filename);
+
+        double best = 0.0, total = 0.0;
+        size_t buffers = pipeline ? pipeline_worker_bytes(pipeline, input.width) : (size_t)3 * (tileWidth + 2);
+        size_t memory_used = buffers * omp_get_max_threads() + sizeof(BMPImage) * 2;
 
-        fread(&header, sizeof(BMPHeader), 1, file);
-        fread(&infoHeader, sizeof(BMPInfoHeader), 1, file);
+        if (numaMode) {
+            // Copias privadas de entrada y salida, cargadas en paralelo con
+            // primer contacto; la salida se escribe al terminar
+            unsigned char *data = malloc(input.dataSize);
+            unsigned char *pixels = malloc(input.dataSize);
+            if (load_rows_first_touch(input.fd, input.header.offset, data, pixels, input.rowSize, input.height) != 0) {
+                printf("No se pudo leer la imagen %s\n", input_filename);
+                free(data);
+                free(pixels);
+                bmp_unmap(&input);
+                continue;
+            }
+
+            // Aplicar el filtro Sobel con OpenMP; con varias repeticiones se
+            // informa el tiempo mínimo y el medio
+            for (int rep = 0; rep < repetitions; rep++) {
+                double start = omp_get_wtime();
+                apply_filter(data, pixels, input.width, input.height, input.rowSize);
+                samples[rep] = omp_get_wtime() - start;
+                total += samples[rep];
+                if (rep == 0 || samples[rep] < best) best = samples[rep];
+            }
 
-        int width = infoHeader.width;
-        int height = abs(infoHeader.height);
-        int rowSize = ((width * 3 + 3) / 4) * 4;
-        int dataSize = rowSize * height;
+            // Guardar la imagen resultante
+            result = bmp_write(output_filename, &input, pixels);
+            if (result != BMP_OK) {
+                printf("No se pudo guardar %s: %s\n", output_filename, bmp_strerror(result));
+            }
+            memory_used += input.dataSize * 2;
 
-        data = malloc(dataSize);
-        output = malloc(dataSize);
+            free(data);
+            free(pixels);
+        } else {
+            // La salida se preasigna y proyecta en memoria: el filtro lee de
+            // la proyección de la entrada y escribe directamente en el archivo
+            // (en el modo por bandas, lee y escribe con pread y pwrite)
+            result = bmp_create(output_filename, &input, &output);
+            if (result != BMP_OK) {
+                printf("No se pudo crear %s: %s\n", output_filename, bmp_strerror(result));
+                bmp_unmap(&input);
+                continue;
+            }
 
-        fseek(file, header.offset, SEEK_SET);
-        fread(data, 1, dataSize, file);
-        fclose(file);
+            // Aplicar el filtro Sobel con OpenMP; con varias repeticiones se
+            // informa el tiempo mínimo y el medio
+            for (int rep = 0; rep < repetitions && result == BMP_OK; rep++) {
+                double start = omp_get_wtime();
+                if (streamRows > 0) result = stream_filter(&input, &output);
+                else apply_filter(input.pixels, output.pixels, input.width, input.height, input.rowSize);
+                samples[rep] = omp_get_wtime() - start;
+                total += samples[rep];
+                if (rep == 0 || samples[rep] < best) best = samples[rep];
+            }
 
-        // Aplicar el filtro Sobel con OpenMP
-        sobel_filter_omp(data, output, width, height);
+            bmp_unmap(&output);
+            if (result != BMP_OK) {
+                printf("No se pudo procesar %s por bandas: %s\n", input_filename, bmp_strerror(result));
+                bmp_unmap(&input);
+                continue;
+            }
+            if (streamRows > 0) memory_used += stream_bytes(input.rowSize);
+        }
 
-        // Guardar la imagen resultante
-        sprintf(output_filename, "images/sobel_openmp_%d.bmp", img);
-        FILE *outFile = fopen(output_filename, "wb");
-        fwrite(&header, sizeof(BMPHeader), 1, outFile);
-        fwrite(&infoHeader, sizeof(BMPInfoHeader), 1, outFile);
-        fseek(outFile, header.offset, SEEK_SET);
-        fwrite(output, 1, dataSize, outFile);
-        fclose(outFile);
+        // Medir el uso de memoria (aproximado, sin contar las proyecciones)
+        printf("Imagen %s procesada con OpenMP. Memoria utilizada: %zu bytes\n", input_filename, memory_used);
+        printf("Tiempo de Cómputo: %.6f segundos (medio %.6f en %d repeticiones)\n",
+               best, total / repetitions, repetitions);
 
-        // Medir el uso de memoria (aproximado)
-        size_t memory_used = dataSize * 2 + sizeof(BMPHeader) + sizeof(BMPInfoHeader);
-        printf("Imagen %d procesada con OpenMP. Memoria utilizada: %zu bytes\n", img, memory_used);
+        // Se leen y escriben los píxeles una vez por repetición
+        char variant[80];
+        snprintf(variant, sizeof(variant), "%s/%s", numaMode ? "numa" : (streamRows > 0 ? "bandas" : "mmap"),
+                 kernelName);
+        BenchInfo info = { "sobel_openmp", variant, input_filename, 1, omp_get_max_threads(),
+                           (double)input.width * input.height, 2.0 * input.dataSize, "GB/s" };
+        bench_report(&info, samples, repetitions);
 
-        free(data);
-        free(output);
+        bmp_unmap(&input);
     }
 
-    printf("Presione Enter para finalizar...");
-    getchar();
+    bmp_free_list(inputs, count);
+    free(samples);
+
+    // Esperar a que el usuario presione Enter solo en ejecuciones
+    // interactivas, para no bloquear trabajos por lotes
+    if (argc == 1 && isatty(STDIN_FILENO)) {
+        printf("Presione Enter para finalizar...");
+        getchar();
+    }
     return 0;
 }
@@ -1,124 +1,312 @@
 // sobel_serial.c
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include "bmp_io.h"
+#include "sobel_simd.h"
+#include "pipeline.h"
+#include "bench.h"
 
-// Estructuras para manejar el encabezado BMP
-#pragma pack(push, 1)
-typedef struct {
-    unsigned short type;
-    unsigned int size;
-    unsigned short reserved1;
-    unsigned short reserved2;
-    unsigned int offset;
-} BMPHeader;
+// Píxeles por bloque al calcular la magnitud de una fila
+#define SOBEL_CHUNK 256
 
-typedef struct {
-    unsigned int size;
-    int width;
-    int height;
-    unsigned short planes;
-    unsigned short bitCount;
-    unsigned int compression;
-    unsigned int imageSize;
-    int xPixelsPerMeter;
-    int yPixelsPerMeter;
-    unsigned int colorsUsed;
-    unsigned int colorsImportant;
-} BMPInfoHeader;
-#pragma pack(pop)
-
-// Función para aplicar el filtro Sobel de forma serial
-void sobel_filter(unsigned char *data, unsigned char *output, int width, int height) {
-    int Gx[3][3] = { {-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1} };
-    int Gy[3][3] = { {-1, -2, -1}, {0, 0, 0}, {1, 2, 1} };
-
-    int rowSize = ((width * 3 + 3) / 4) * 4; // Alineación a 4 bytes
-    unsigned char *grayData = malloc(width * height);
-
-    // Convertir a escala de grises
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int pos = y * rowSize + x * 3;
-            unsigned char gray = (data[pos] + data[pos + 1] + data[pos + 2]) / 3;
-            grayData[y * width + x] = gray;
+// Núcleo de magnitud Sobel elegido en tiempo de ejecución
+static sobel_mag_fn sobel_mag;
+
+// Cadena de filtros elegida con -f (NULL: Sobel clásico)
+static Pipeline *pipeline;
+
+// Modo por bandas (-b FILAS o SOBEL_STREAM=FILAS; 0: imagen proyectada
+// completa) y búferes del lector: la banda en uso y dos leídas por adelantado
+static int streamRows = 0;
+#define STREAM_DEPTH 3
+
+// Aplicar el filtro Sobel a la fila 'cur' usando sus filas vecinas en gris.
+// La magnitud se calcula por bloques con el núcleo seleccionado para la CPU
+// y luego se replica en los tres canales de la fila de salida.
+void sobel_row(const unsigned char *prev, const unsigned char *cur, const unsigned char *next,
+               unsigned char *out, int width) {
+    unsigned char mag[SOBEL_CHUNK];
+
+    for (int x = 1; x < width - 1; x += SOBEL_CHUNK) {
+        int n = (width - 1 - x < SOBEL_CHUNK) ? width - 1 - x : SOBEL_CHUNK;
+        sobel_mag(prev + x, cur + x, next + x, mag, n);
+
+        for (int i = 0; i < n; i++) {
+            int pos = (x + i) * 3;
+            out[pos] = mag[i];
+            out[pos + 1] = mag[i];
+            out[pos + 2] = mag[i];
         }
     }
+}
 
-    // Aplicar el filtro Sobel
-    for (int y = 1; y < height - 1; y++) {
-        for (int x = 1; x < width - 1; x++) {
-            int gx = 0, gy = 0;
-            for (int i = -1; i <= 1; i++) {
-                for (int j = -1; j <= 1; j++) {
-                    int pixel = grayData[(y + i) * width + (x + j)];
-                    gx += Gx[i + 1][j + 1] * pixel;
-                    gy += Gy[i + 1][j + 1] * pixel;
-                }
-            }
-            int magnitude = (int)sqrt(gx * gx + gy * gy);
-            if (magnitude > 255) magnitude = 255;
-            int pos = y * rowSize + x * 3;
-            output[pos] = magnitude;
-            output[pos + 1] = magnitude;
-            output[pos + 2] = magnitude;
+// Aplicar el filtro Sobel a las filas [start, end) en una sola pasada.
+// Las filas se convierten a gris bajo demanda en un búfer circular de tres
+// filas ('lines', 3 * width bytes), de modo que no se necesita una imagen
+// completa en escala de grises.
+void sobel_rows(const unsigned char *data, unsigned char *output, unsigned char *lines,
+                int width, int rowSize, int start, int end) {
+    if (start >= end) return;
+
+    sobel_gray_row(data + (size_t)(start - 1) * rowSize, lines + ((start - 1) % 3) * width, width);
+    sobel_gray_row(data + (size_t)start * rowSize, lines + (start % 3) * width, width);
+
+    for (int y = start; y < end; y++) {
+        sobel_gray_row(data + (size_t)(y + 1) * rowSize, lines + ((y + 1) % 3) * width, width);
+        sobel_row(lines + ((y - 1) % 3) * width, lines + (y % 3) * width, lines + ((y + 1) % 3) * width,
+                  output + (size_t)y * rowSize, width);
+    }
+}
+
+// Función para aplicar el filtro Sobel de forma serial.
+// 'data' y 'output' tienen filas de 'rowSize' bytes (pueden apuntar
+// directamente a imágenes proyectadas en memoria).
+void sobel_filter(const unsigned char *data, unsigned char *output, int width, int height, int rowSize) {
+    unsigned char *lines = malloc(3 * width);
+
+    sobel_rows(data, output, lines, width, rowSize, 1, height - 1);
+
+    free(lines);
+}
+
+// Filas de la entrada para la cadena de filtros; 'data' es la fila 'first'
+typedef struct {
+    const unsigned char *data;
+    int first, width, rowSize;
+} GrayRows;
+
+void load_gray_row(void *ctx, int y, unsigned char *gray) {
+    const GrayRows *rows = ctx;
+    sobel_gray_row(rows->data + (size_t)(y - rows->first) * rows->rowSize, gray, rows->width);
+}
+
+// Aplicar la cadena elegida con -f a la imagen completa. Con histéresis, los
+// bordes se siguen después sobre la propia salida.
+void pipeline_filter(const unsigned char *data, unsigned char *output, int width, int height, int rowSize) {
+    PipelineWorker *worker = pipeline_worker_new(pipeline, width, height);
+    GrayRows rows = { data, 0, width, rowSize };
+
+    pipeline_band(worker, load_gray_row, &rows, output, rowSize, 0, height);
+    if (pipeline->hysteresis) {
+        pipeline_grow(output, width, rowSize, height, 0, height);
+        pipeline_finish(output, width, rowSize, height);
+    }
+
+    pipeline_worker_free(worker);
+}
+
+// Calcular las filas de salida [lo, hi) a partir de una ventana de la
+// entrada que empieza en la fila 'first' de la imagen y contiene todas las
+// filas vecinas que necesitan. 'out' apunta a la fila lo y va precedido de
+// una fila libre, que el Sobel clásico usa como borde sin escribirla.
+void filter_window(const unsigned char *window, int first, unsigned char *out, PipelineWorker *worker,
+                   int width, int height, int rowSize, int lo, int hi) {
+    if (worker != NULL) {
+        GrayRows rows = { window, first, width, rowSize };
+        pipeline_band(worker, load_gray_row, &rows, out, rowSize, lo, hi);
+        if (pipeline->hysteresis) pipeline_grow(out, width, rowSize, hi - lo, 0, hi - lo);
+        return;
+    }
+
+    // Las filas de borde de la imagen quedan a cero, como en bmp_create
+    if (lo == 0) memset(out, 0, rowSize);
+    if (hi == height) memset(out + (size_t)(height - 1 - lo) * rowSize, 0, rowSize);
+    int start = (lo > 1) ? lo : 1;
+    int end = (hi < height - 1) ? hi : height - 1;
+    if (start < end) {
+        sobel_filter(window + (size_t)(start - 1 - first) * rowSize, out + (size_t)(start - 1 - lo) * rowSize,
+                     width, end - start + 2, rowSize);
+    }
+}
+
+// Modo por bandas: la entrada se lee por bandas de streamRows filas con
+// lectura anticipada (bmp_reader_open) y cada banda de salida se escribe en
+// el archivo en cuanto está calculada, de modo que la memoria usada depende
+// del tamaño de banda y no del alto de la imagen. Cada banda trae 2R filas de
+// la anterior (R: radio del filtro) y la salida se calcula con R filas de
+// retraso respecto a la entrada leída. Con histéresis, los bordes que cruzan
+// de una banda a otra y el descarte de los débiles se resuelven al final
+// sobre la proyección de la salida.
+int stream_filter(const BMPImage *input, BMPImage *output) {
+    int width = input->width, height = input->height, rowSize = input->rowSize;
+    int radius = pipeline ? pipeline->radius : 1;
+    int band = (streamRows > 2 * radius) ? streamRows : 2 * radius;
+
+    BMPReader *reader = bmp_reader_open(input, band, 2 * radius, STREAM_DEPTH);
+    unsigned char *buffer = calloc((size_t)band + radius + 1, rowSize);
+    if (reader == NULL || buffer == NULL) {
+        if (reader != NULL) bmp_reader_close(reader);
+        free(buffer);
+        return BMP_ERR_IO;
+    }
+    PipelineWorker *worker = pipeline ? pipeline_worker_new(pipeline, width, height) : NULL;
+
+    const unsigned char *window;
+    int first, rows, result = BMP_OK;
+    while (result == BMP_OK && (window = bmp_reader_next(reader, &first, &rows)) != NULL) {
+        int lo = (first == 0) ? 0 : first + radius;
+        int hi = (first + rows == height) ? height : first + rows - radius;
+        filter_window(window, first, buffer + rowSize, worker, width, height, rowSize, lo, hi);
+        result = bmp_write_rows(output, lo, hi - lo, buffer + rowSize);
+    }
+    if (bmp_reader_close(reader) != BMP_OK) result = BMP_ERR_IO;
+
+    if (result == BMP_OK && pipeline != NULL && pipeline->hysteresis) {
+        for (int y = band - radius; y + radius < height; y += band) {
+            pipeline_grow(output->pixels, width, rowSize, height, y - 1, y + 1);
         }
+        pipeline_finish(output->pixels, width, rowSize, height);
     }
 
-    free(grayData);
+    if (worker != NULL) pipeline_worker_free(worker);
+    free(buffer);
+    return result;
 }
 
-int main() {
-    BMPHeader header;
-    BMPInfoHeader infoHeader;
-    unsigned char *data, *output;
-    char input_filename[50];
-    char output_filename[50];
-
-    for (int img = 1; img <= 5; img++) {
-        sprintf(input_filename, "images/%d.bmp", img);
-        FILE *file = fopen(input_filename, "rb");
-        if (!file) {
-            printf("No se pudo abrir la imagen %s\n", input_filename);
-            continue;
+// Memoria del modo por bandas: búferes del lector y de la banda de salida
+size_t stream_bytes(int rowSize) {
+    int radius = pipeline ? pipeline->radius : 1;
+    int band = (streamRows > 2 * radius) ? streamRows : 2 * radius;
+    return ((size_t)STREAM_DEPTH * (band + 2 * radius) + band + radius + 1) * rowSize;
+}
+
+// Segundos transcurridos desde un instante arbitrario
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    BMPImage input, output;
+    char output_filename[PATH_MAX];
+
+    // Opciones: -o DIRECTORIO para las salidas, -r para repetir el filtro
+    // sobre cada imagen, -f para elegir otro filtro o una cadena de filtros
+    // (pipeline.h) y -b para procesar por bandas de filas (tiene prioridad
+    // sobre SOBEL_STREAM); el resto de argumentos son imágenes o directorios
+    const char *outputDir = NULL;
+    int repetitions = 1;
+    Pipeline selected;
+    const char *stream = getenv("SOBEL_STREAM");
+    int opt;
+    if (stream != NULL && atoi(stream) > 0) streamRows = atoi(stream);
+    while ((opt = getopt(argc, argv, "o:r:f:b:")) != -1) {
+        int valid = 1;
+        switch (opt) {
+            case 'o': outputDir = optarg; break;
+            case 'r': repetitions = atoi(optarg); valid = (repetitions > 0); break;
+            case 'f':
+                valid = (pipeline_parse(optarg, &selected) == 0);
+                pipeline = &selected;
+                break;
+            case 'b': streamRows = atoi(optarg); valid = (streamRows > 0); break;
+            default: valid = 0;
         }
+        if (!valid) {
+            fprintf(stderr, "Uso: %s [-o directorio_salida] [-r repeticiones] [-f filtro] [-b filas] "
+                            "[imagen.bmp | directorio]...\n", argv[0]);
+            return 1;
+        }
+    }
 
-        fread(&header, sizeof(BMPHeader), 1, file);
-        fread(&infoHeader, sizeof(BMPInfoHeader), 1, file);
+    const char *kernelName;
+    sobel_mag = sobel_mag_select(&kernelName);
+    char outputPrefix[64] = "sobel_serial_";
+    if (pipeline != NULL) {
+        kernelName = pipeline->name;
+        snprintf(outputPrefix, sizeof(outputPrefix), "sobel_serial_%.48s_", pipeline->name);
+        char stages[256];
+        pipeline_describe(pipeline, stages, sizeof(stages));
+        printf("Filtro: %s (radio %d: %s)\n", pipeline->name, pipeline->radius, stages);
+    } else {
+        printf("Núcleo Sobel: %s\n", kernelName);
+    }
+    if (streamRows > 0) {
+        printf("Modo por bandas: %d filas por banda, %d bandas leídas por adelantado\n",
+               streamRows, STREAM_DEPTH - 1);
+    }
 
-        int width = infoHeader.width;
-        int height = abs(infoHeader.height);
-        int rowSize = ((width * 3 + 3) / 4) * 4; // Alineación a 4 bytes
-        int dataSize = rowSize * height;
+    int count;
+    char **inputs = bmp_list_inputs(argc - optind, argv + optind, 1, 5, &count);
+    double *samples = malloc(repetitions * sizeof(double));
 
-        data = malloc(dataSize);
-        output = malloc(dataSize);
+    for (int img = 0; img < count; img++) {
+        const char *input_filename = inputs[img];
+        int result = bmp_map(input_filename, &input);
+        if (result != BMP_OK) {
+            printf("No se pudo abrir la imagen %s: %s\n", input_filename, bmp_strerror(result));
+            continue;
+        }
 
-        fseek(file, header.offset, SEEK_SET);
-        fread(data, 1, dataSize, file);
-        fclose(file);
+        // La salida se preasigna y proyecta en memoria: el filtro escribe
+        // directamente en el archivo (en el modo por bandas, con pwrite)
+        bmp_output_name(input_filename, outputDir, outputPrefix, output_filename);
+        result = bmp_create(output_filename, &input, &output);
+        if (result != BMP_OK) {
+            printf("No se pudo crear %s: %s\n", output_filename, bmp_strerror(result));
+            bmp_unmap(&input);
+            continue;
+        }
 
-        // Aplicar el filtro Sobel
-        sobel_filter(data, output, width, height);
+        // Aplicar el filtro Sobel; con varias repeticiones se informa el
+        // tiempo mínimo y el medio
+        double best = 0.0, total = 0.0;
+        for (int rep = 0; rep < repetitions; rep++) {
+            double start = wall_time();
+            if (streamRows > 0) {
+                result = stream_filter(&input, &output);
+            } else if (pipeline != NULL) {
+                pipeline_filter(input.pixels, output.pixels, input.width, input.height, input.rowSize);
+            } else {
+                sobel_filter(input.pixels, output.pixels, input.width, input.height, input.rowSize);
+            }
+            samples[rep] = wall_time() - start;
+            total += samples[rep];
+            if (rep == 0 || samples[rep] < best) best = samples[rep];
+            if (result != BMP_OK) break;
+        }
+        if (result != BMP_OK) {
+            printf("No se pudo procesar %s por bandas: %s\n", input_filename, bmp_strerror(result));
+            bmp_unmap(&output);
+            bmp_unmap(&input);
+            continue;
+        }
 
-        // Guardar la imagen resultante
-        sprintf(output_filename, "images/sobel_serial_%d.bmp", img);
-        FILE *outFile = fopen(output_filename, "wb");
-        fwrite(&header, sizeof(BMPHeader), 1, outFile);
-        fwrite(&infoHeader, sizeof(BMPInfoHeader), 1, outFile);
-        fseek(outFile, header.offset, SEEK_SET);
-        fwrite(output, 1, dataSize, outFile);
-        fclose(outFile);
+        // Se leen y escriben los píxeles una vez por repetición
+        char variant[80];
+        snprintf(variant, sizeof(variant), "%s%s", streamRows > 0 ? "bandas/" : "", kernelName);
+        BenchInfo info = { "sobel_serial", variant, input_filename, 1, 1,
+                           (double)input.width * input.height, 2.0 * input.dataSize, "GB/s" };
+        bench_report(&info, samples, repetitions);
 
-        // Medir el uso de memoria (aproximado)
-        size_t memory_used = dataSize * 2 + sizeof(BMPHeader) + sizeof(BMPInfoHeader);
-        printf("Imagen %d procesada. Memoria utilizada: %zu bytes\n", img, memory_used);
+        // Medir el uso de memoria (aproximado): solo el búfer de filas del
+        // filtro (y los de las bandas), la entrada y la salida están
+        // proyectadas desde sus archivos
+        size_t memory_used = (pipeline ? pipeline_worker_bytes(pipeline, input.width) : 3 * (size_t)input.width)
+                             + (streamRows > 0 ? stream_bytes(input.rowSize) : 0) + sizeof(BMPImage) * 2;
+        printf("Imagen %s procesada. Memoria utilizada: %zu bytes (%zu bytes proyectados)\n",
+               input_filename, memory_used, input.mapSize + output.mapSize);
+        printf("Tiempo de Cómputo: %.6f segundos (medio %.6f en %d repeticiones)\n",
+               best, total / repetitions, repetitions);
 
-        free(data);
-        free(output);
+        bmp_unmap(&output);
+        bmp_unmap(&input);
     }
 
-    printf("Presione Enter para finalizar...");
-    getchar();
+    bmp_free_list(inputs, count);
+    free(samples);
+
+    // Esperar a que el usuario presione Enter solo en ejecuciones
+    // interactivas, para no bloquear trabajos por lotes
+    if (argc == 1 && isatty(STDIN_FILENO)) {
+        printf("Presione Enter para finalizar...");
+        getchar();
+    }
     return 0;
 }
@@ -0,0 +1,842 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "bench.h"
+#include "mpi_trace.h"
+
+#define DEFAULT_GRID 1000       // Laplaciano de 1000x1000 puntos si no se da archivo
+#define DEFAULT_COLUMNS 8       // Columnas de la matriz densa en SpMM
+#define DEFAULT_REPETITIONS 10  // Repeticiones de cada producto para medir
+#define CHECK_TOLERANCE 1e-12   // Error relativo admitido al verificar
+#define EXCHANGE_TAG 300
+
+// Valor del elemento (fila, col) de los vectores/matrices densos de entrada
+static inline double dense_value(long row, int col) {
+    return 1.0 + (double)((row * 7 + col * 3) % 17) / 16.0;
+}
+
+// Matriz dispersa distribuida por bloques de filas. Las columnas propias
+// (las filas del mismo proceso) y las de otros procesos se guardan en dos
+// matrices CSR separadas: la parte local se multiplica mientras llegan los
+// valores remotos.
+typedef struct {
+    long n;                 // Filas (y columnas) globales
+    long nnz;               // No nulos globales
+    long *row_starts;       // Primera fila de cada proceso (P + 1 valores)
+    long first_row;
+    int rows;               // Filas locales
+    long local_nnz;
+    int *local_ptr, *local_col;   // Columnas propias (índice local)
+    double *local_val;
+    int *remote_ptr, *remote_col; // Columnas remotas (índice de fantasma)
+    double *remote_val;
+    int ghosts;             // Columnas remotas distintas
+    long *ghost_global;     // Índice global de cada fantasma, ordenado
+} DistMatrix;
+
+// Intercambio con los vecinos: solo los procesos que poseen columnas
+// remotas de este proceso o que necesitan columnas propias
+typedef struct {
+    int recv_neighbors;
+    int *recv_ranks, *recv_counts, *recv_offsets;   // Fantasmas por vecino
+    int send_neighbors;
+    int *send_ranks, *send_counts, *send_offsets;
+    int *send_index;        // Filas locales a enviar, agrupadas por vecino
+    int total_send;
+} Exchange;
+
+// Métricas de comunicación y cómputo de una operación
+typedef struct {
+    long bytes_sent;
+    long bytes_received;
+    double comp_time;
+    double comm_time;
+    double flops;
+} Metrics;
+
+// Matriz global en CSR provisional, con índices de columna globales
+typedef struct {
+    int rows;
+    int *ptr;
+    long *col;
+    double *val;
+} RowBlock;
+
+// Fuente de la matriz: número de no nulos en las filas [0, row)
+typedef long (*nnz_before_fn)(long row, const void *ctx);
+
+// Reparto por número de no nulos: el proceso r recibe las filas cuya suma
+// acumulada de no nulos cae en [r * nnz / P, (r + 1) * nnz / P)
+static void partition_by_nnz(long n, long nnz, int size, nnz_before_fn nnz_before, const void *ctx, long *row_starts) {
+    row_starts[0] = 0;
+    row_starts[size] = n;
+    for (int r = 1; r < size; r++) {
+        long target = (long)((double)nnz * r / size);
+        // Primera fila con nnz_before(fila) >= target
+        long lo = row_starts[r - 1], hi = n;
+        while (lo < hi) {
+            long mid = lo + (hi - lo) / 2;
+            if (nnz_before(mid, ctx) < target) lo = mid + 1;
+            else hi = mid;
+        }
+        row_starts[r] = lo;
+    }
+}
+
+// Proceso dueño de la fila (o columna) global 'row'
+static int owner_of(const long *row_starts, int size, long row) {
+    int lo = 0, hi = size - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (row_starts[mid] <= row) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// ---------------------------------------------------------------------------
+// Laplaciano 2D de 5 puntos sobre una malla de g x g (n = g^2 filas)
+
+static long laplacian_nnz_before(long row, const void *ctx) {
+    long g = *(const long *)ctx;
+    long lines = row / g, rest = row % g;
+    // Líneas completas: 5 por punto menos los bordes izquierdo y derecho, y
+    // una línea de vecinos menos en la primera y en la última línea
+    long count = lines * (5 * g - 2);
+    if (lines > 0) count -= g;
+    if (lines >= g) count -= g;
+    // Puntos [0, rest) de la línea incompleta
+    if (rest > 0) {
+        count += 5 * rest - 1;
+        if (lines == 0) count -= rest;
+        if (lines == g - 1) count -= rest;
+    }
+    return count;
+}
+
+static void laplacian_rows(long g, long first_row, int rows, RowBlock *block) {
+    block->rows = rows;
+    block->ptr = malloc((rows + 1) * sizeof(int));
+    long nnz = laplacian_nnz_before(first_row + rows, &g) - laplacian_nnz_before(first_row, &g);
+    block->col = malloc(nnz * sizeof(long));
+    block->val = malloc(nnz * sizeof(double));
+
+    int k = 0;
+    block->ptr[0] = 0;
+    for (int r = 0; r < rows; r++) {
+        long row = first_row + r, i = row / g, j = row % g;
+        if (i > 0)     { block->col[k] = row - g; block->val[k++] = -1.0; }
+        if (j > 0)     { block->col[k] = row - 1; block->val[k++] = -1.0; }
+        block->col[k] = row; block->val[k++] = 4.0;
+        if (j < g - 1) { block->col[k] = row + 1; block->val[k++] = -1.0; }
+        if (i < g - 1) { block->col[k] = row + g; block->val[k++] = -1.0; }
+        block->ptr[r + 1] = k;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Archivos Matrix Market (formato coordinate; real, integer o pattern;
+// general, symmetric o skew-symmetric). Cada proceso lee solo su rango de
+// bytes del archivo, una vez; los no nulos por fila se suman entre todos
+// para el reparto y cada entrada se envía después al dueño de su fila, de
+// modo que el trabajo de lectura por proceso es O(nnz / P).
+
+typedef struct {
+    FILE *file;
+    long rows, cols, entries;
+    int pattern;            // Sin valores: todos los no nulos valen 1
+    int symmetry;           // 0 general, 1 symmetric, -1 skew-symmetric
+    long data_start;        // Posición de la primera entrada
+    long pos;               // Posición de la siguiente línea a leer
+} MatrixMarket;
+
+// Entrada de la matriz con índices globales base 0
+typedef struct {
+    long row, col;
+    double val;
+} MMEntry;
+
+static int mm_open(const char *path, MatrixMarket *mm) {
+    char line[1024], object[64], format[64], field[64], symmetry[64];
+    memset(mm, 0, sizeof(MatrixMarket));
+    mm->file = fopen(path, "r");
+    if (mm->file == NULL) return -1;
+
+    // La cabecera no distingue mayúsculas de minúsculas
+    if (fgets(line, sizeof(line), mm->file) == NULL) return -2;
+    for (char *c = line; *c; c++) *c = tolower((unsigned char)*c);
+    if (sscanf(line, "%%%%matrixmarket %63s %63s %63s %63s", object, format, field, symmetry) != 4) return -2;
+    if (strcmp(object, "matrix") != 0 || strcmp(format, "coordinate") != 0) return -2;
+    if (strcmp(field, "complex") == 0) return -2;
+    mm->pattern = (strcmp(field, "pattern") == 0);
+    if (strcmp(symmetry, "symmetric") == 0) mm->symmetry = 1;
+    else if (strcmp(symmetry, "skew-symmetric") == 0) mm->symmetry = -1;
+    else if (strcmp(symmetry, "general") != 0) return -2;
+
+    // Saltar comentarios hasta la línea de tamaños
+    do {
+        if (fgets(line, sizeof(line), mm->file) == NULL) return -2;
+    } while (line[0] == '%');
+    if (sscanf(line, "%ld %ld %ld", &mm->rows, &mm->cols, &mm->entries) != 3) return -2;
+    if (mm->rows != mm->cols || mm->rows <= 0 || mm->entries < 0) return -3;
+
+    mm->data_start = ftell(mm->file);
+    return 0;
+}
+
+// Colocarse en la primera línea que empieza en [start, ...): se descarta el
+// resto de la línea que contiene el byte start - 1
+static void mm_seek(MatrixMarket *mm, long start) {
+    char line[1024];
+    if (start <= mm->data_start) {
+        fseek(mm->file, mm->data_start, SEEK_SET);
+        mm->pos = mm->data_start;
+        return;
+    }
+    fseek(mm->file, start - 1, SEEK_SET);
+    mm->pos = start - 1;
+    while (fgets(line, sizeof(line), mm->file) != NULL) {
+        mm->pos += strlen(line);
+        if (line[strlen(line) - 1] == '\n') break;
+    }
+}
+
+// Leer la siguiente entrada (índices base 0) de las líneas que empiezan
+// antes de 'end', saltando líneas vacías y comentarios. Devuelve 1 si hay
+// entrada, 0 al terminar el rango y -1 si la línea no se puede leer o sus
+// índices quedan fuera de la matriz.
+static int mm_next(MatrixMarket *mm, long end, MMEntry *entry) {
+    char line[1024];
+    for (;;) {
+        if (mm->pos >= end || fgets(line, sizeof(line), mm->file) == NULL) return 0;
+        mm->pos += strlen(line);
+        char *text = line + strspn(line, " \t\r\n");
+        if (*text == '\0' || *text == '%') continue;
+
+        int fields = sscanf(text, "%ld %ld %lf", &entry->row, &entry->col, &entry->val);
+        if (fields < (mm->pattern ? 2 : 3)) return -1;
+        if (mm->pattern) entry->val = 1.0;
+        entry->row--;
+        entry->col--;
+        if (entry->row < 0 || entry->row >= mm->rows || entry->col < 0 || entry->col >= mm->rows) return -1;
+        return 1;
+    }
+}
+
+static long mm_nnz_before(long row, const void *ctx) {
+    return ((const long *)ctx)[row];
+}
+
+// Leer las entradas del rango de bytes propio. Devuelve el arreglo de
+// entradas y su número en *count, o NULL si alguna es inválida.
+static MMEntry *mm_read_range(MatrixMarket *mm, int rank, int size, long *count) {
+    fseek(mm->file, 0, SEEK_END);
+    long data = ftell(mm->file) - mm->data_start;
+    long start = mm->data_start + (long)((double)data * rank / size);
+    long end = mm->data_start + (long)((double)data * (rank + 1) / size);
+
+    long capacity = 1024;
+    MMEntry *entries = malloc(capacity * sizeof(MMEntry));
+    int status = 0;
+    *count = 0;
+    mm_seek(mm, start);
+    while (entries != NULL && (status = mm_next(mm, end, &entries[*count])) == 1) {
+        if (++*count == capacity) {
+            capacity *= 2;
+            entries = realloc(entries, capacity * sizeof(MMEntry));
+        }
+    }
+    if (entries == NULL || status < 0) {
+        free(entries);
+        return NULL;
+    }
+    return entries;
+}
+
+// No nulos por fila (incluidas las entradas simétricas) sumados entre todos
+// los procesos y su suma acumulada, para el reparto
+static long *mm_row_prefix(const MatrixMarket *mm, const MMEntry *entries, long count) {
+    long *prefix = calloc(mm->rows + 1, sizeof(long));
+    for (long e = 0; e < count; e++) {
+        prefix[entries[e].row + 1]++;
+        if (mm->symmetry != 0 && entries[e].row != entries[e].col) prefix[entries[e].col + 1]++;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, prefix + 1, (int)mm->rows, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    for (long i = 0; i < mm->rows; i++) prefix[i + 1] += prefix[i];
+    return prefix;
+}
+
+// Enviar cada entrada (y su simétrica) al dueño de su fila y montar las
+// filas propias. Las entradas llegan ordenadas por proceso de origen, es
+// decir, en el orden del archivo.
+static void mm_rows(const MatrixMarket *mm, const MMEntry *entries, long count, const long *prefix,
+                    const long *row_starts, int size, long first_row, int rows, RowBlock *block) {
+    int *send_counts = calloc(size, sizeof(int));
+    int *recv_counts = malloc(size * sizeof(int));
+    int *send_offsets = malloc((size + 1) * sizeof(int));
+    int *recv_offsets = malloc((size + 1) * sizeof(int));
+    for (long e = 0; e < count; e++) {
+        send_counts[owner_of(row_starts, size, entries[e].row)]++;
+        if (mm->symmetry != 0 && entries[e].row != entries[e].col) {
+            send_counts[owner_of(row_starts, size, entries[e].col)]++;
+        }
+    }
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+    send_offsets[0] = recv_offsets[0] = 0;
+    for (int r = 0; r < size; r++) {
+        send_offsets[r + 1] = send_offsets[r] + send_counts[r];
+        recv_offsets[r + 1] = recv_offsets[r] + recv_counts[r];
+    }
+
+    MMEntry *send = malloc(((size_t)send_offsets[size] + 1) * sizeof(MMEntry));
+    MMEntry *recv = malloc(((size_t)recv_offsets[size] + 1) * sizeof(MMEntry));
+    if (send == NULL || recv == NULL) {
+        fprintf(stderr, "No se pudo asignar memoria para repartir la matriz\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    int *fill = malloc(size * sizeof(int));
+    memcpy(fill, send_offsets, size * sizeof(int));
+    for (long e = 0; e < count; e++) {
+        send[fill[owner_of(row_starts, size, entries[e].row)]++] = entries[e];
+        if (mm->symmetry != 0 && entries[e].row != entries[e].col) {
+            MMEntry mirror = { entries[e].col, entries[e].row, mm->symmetry * entries[e].val };
+            send[fill[owner_of(row_starts, size, mirror.row)]++] = mirror;
+        }
+    }
+
+    MPI_Datatype entry_type;
+    MPI_Type_contiguous(sizeof(MMEntry), MPI_BYTE, &entry_type);
+    MPI_Type_commit(&entry_type);
+    MPI_Alltoallv(send, send_counts, send_offsets, entry_type, recv, recv_counts, recv_offsets, entry_type,
+                  MPI_COMM_WORLD);
+    MPI_Type_free(&entry_type);
+
+    long base = prefix[first_row];
+    long nnz = prefix[first_row + rows] - base;
+    block->rows = rows;
+    block->ptr = malloc((rows + 1) * sizeof(int));
+    block->col = malloc(nnz * sizeof(long));
+    block->val = malloc(nnz * sizeof(double));
+    for (int r = 0; r <= rows; r++) block->ptr[r] = (int)(prefix[first_row + r] - base);
+
+    int *next = realloc(fill, (rows + 1) * sizeof(int));
+    memcpy(next, block->ptr, rows * sizeof(int));
+    for (int e = 0; e < recv_offsets[size]; e++) {
+        int k = next[recv[e].row - first_row]++;
+        block->col[k] = recv[e].col;
+        block->val[k] = recv[e].val;
+    }
+
+    free(next);
+    free(send);
+    free(recv);
+    free(send_counts);
+    free(recv_counts);
+    free(send_offsets);
+    free(recv_offsets);
+}
+
+// ---------------------------------------------------------------------------
+// Distribución
+
+static int compare_long(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// Separar las filas propias en parte local y remota y numerar las columnas
+// remotas como fantasmas, ordenadas por índice global (y por tanto por dueño)
+static void build_matrix(DistMatrix *A, RowBlock *block) {
+    long last_row = A->first_row + A->rows;
+    long nnz = block->ptr[block->rows];
+    A->local_nnz = nnz;
+
+    long remote = 0;
+    for (long k = 0; k < nnz; k++) {
+        if (block->col[k] < A->first_row || block->col[k] >= last_row) remote++;
+    }
+
+    // Columnas remotas distintas
+    long *ghosts = malloc((remote > 0 ? remote : 1) * sizeof(long));
+    long count = 0;
+    for (long k = 0; k < nnz; k++) {
+        if (block->col[k] < A->first_row || block->col[k] >= last_row) ghosts[count++] = block->col[k];
+    }
+    qsort(ghosts, count, sizeof(long), compare_long);
+    int unique = 0;
+    for (long k = 0; k < count; k++) {
+        if (unique == 0 || ghosts[unique - 1] != ghosts[k]) ghosts[unique++] = ghosts[k];
+    }
+    A->ghosts = unique;
+    A->ghost_global = ghosts;
+
+    A->local_ptr = malloc((A->rows + 1) * sizeof(int));
+    A->remote_ptr = malloc((A->rows + 1) * sizeof(int));
+    A->local_col = malloc((nnz - remote + 1) * sizeof(int));
+    A->local_val = malloc((nnz - remote + 1) * sizeof(double));
+    A->remote_col = malloc((remote + 1) * sizeof(int));
+    A->remote_val = malloc((remote + 1) * sizeof(double));
+
+    int nl = 0, nr = 0;
+    A->local_ptr[0] = A->remote_ptr[0] = 0;
+    for (int r = 0; r < A->rows; r++) {
+        for (int k = block->ptr[r]; k < block->ptr[r + 1]; k++) {
+            long col = block->col[k];
+            if (col >= A->first_row && col < last_row) {
+                A->local_col[nl] = (int)(col - A->first_row);
+                A->local_val[nl++] = block->val[k];
+            } else {
+                long *found = bsearch(&col, A->ghost_global, A->ghosts, sizeof(long), compare_long);
+                A->remote_col[nr] = (int)(found - A->ghost_global);
+                A->remote_val[nr++] = block->val[k];
+            }
+        }
+        A->local_ptr[r + 1] = nl;
+        A->remote_ptr[r + 1] = nr;
+    }
+
+    free(block->ptr);
+    free(block->col);
+    free(block->val);
+}
+
+// Preparar el intercambio con los vecinos: cada proceso comunica a los
+// dueños qué columnas necesita (una sola vez); en cada producto solo se
+// envían esos valores
+static void build_exchange(const DistMatrix *A, int rank, int size, Exchange *ex) {
+    int *need = calloc(size, sizeof(int));
+    int *give = malloc(size * sizeof(int));
+    for (int g = 0; g < A->ghosts; g++) {
+        need[owner_of(A->row_starts, size, A->ghost_global[g])]++;
+    }
+    MPI_Alltoall(need, 1, MPI_INT, give, 1, MPI_INT, MPI_COMM_WORLD);
+
+    ex->recv_neighbors = ex->send_neighbors = 0;
+    ex->recv_ranks = malloc(size * sizeof(int));
+    ex->recv_counts = malloc(size * sizeof(int));
+    ex->recv_offsets = malloc(size * sizeof(int));
+    ex->send_ranks = malloc(size * sizeof(int));
+    ex->send_counts = malloc(size * sizeof(int));
+    ex->send_offsets = malloc(size * sizeof(int));
+    ex->total_send = 0;
+    for (int r = 0, offset = 0; r < size; r++) {
+        if (need[r] > 0) {
+            ex->recv_ranks[ex->recv_neighbors] = r;
+            ex->recv_counts[ex->recv_neighbors] = need[r];
+            ex->recv_offsets[ex->recv_neighbors++] = offset;
+            offset += need[r];
+        }
+        if (give[r] > 0 && r != rank) {
+            ex->send_ranks[ex->send_neighbors] = r;
+            ex->send_counts[ex->send_neighbors] = give[r];
+            ex->send_offsets[ex->send_neighbors++] = ex->total_send;
+            ex->total_send += give[r];
+        }
+    }
+
+    // Enviar a cada dueño la lista de columnas globales que se necesitan
+    long *requested = malloc((ex->total_send + 1) * sizeof(long));
+    MPI_Request *requests = malloc((ex->recv_neighbors + ex->send_neighbors) * sizeof(MPI_Request));
+    int nreq = 0;
+    for (int i = 0; i < ex->send_neighbors; i++) {
+        MPI_Irecv(requested + ex->send_offsets[i], ex->send_counts[i], MPI_LONG,
+                  ex->send_ranks[i], EXCHANGE_TAG, MPI_COMM_WORLD, &requests[nreq++]);
+    }
+    for (int i = 0; i < ex->recv_neighbors; i++) {
+        MPI_Isend(A->ghost_global + ex->recv_offsets[i], ex->recv_counts[i], MPI_LONG,
+                  ex->recv_ranks[i], EXCHANGE_TAG, MPI_COMM_WORLD, &requests[nreq++]);
+    }
+    MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+
+    ex->send_index = malloc((ex->total_send + 1) * sizeof(int));
+    for (int i = 0; i < ex->total_send; i++) {
+        ex->send_index[i] = (int)(requested[i] - A->first_row);
+    }
+
+    free(requested);
+    free(requests);
+    free(need);
+    free(give);
+}
+
+// ---------------------------------------------------------------------------
+// Productos
+
+// Y (rows x k) = A * X (o Y += A * X con 'accumulate') para una matriz CSR
+static void csr_multiply(int rows, const int *ptr, const int *col, const double *val, int k,
+                         const double *X, double *Y, int accumulate) {
+    if (k == 1) {
+        // SpMV: acumular cada fila en un registro
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
+        for (int r = 0; r < rows; r++) {
+            double sum = accumulate ? Y[r] : 0.0;
+            for (int p = ptr[r]; p < ptr[r + 1]; p++) sum += val[p] * X[col[p]];
+            Y[r] = sum;
+        }
+        return;
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (int r = 0; r < rows; r++) {
+        double *y = Y + (size_t)r * k;
+        if (!accumulate) {
+            for (int j = 0; j < k; j++) y[j] = 0.0;
+        }
+        for (int p = ptr[r]; p < ptr[r + 1]; p++) {
+            const double *x = X + (size_t)col[p] * k;
+            double a = val[p];
+            for (int j = 0; j < k; j++) y[j] += a * x[j];
+        }
+    }
+}
+
+// Y (rows x k) = A * X, con X de las filas propias (rows x k) y los valores
+// de las columnas remotas en 'ghost' (ghosts x k). La parte local se calcula
+// mientras llegan los fantasmas. Con k = 1 es SpMV.
+static void spmm(const DistMatrix *A, const Exchange *ex, int k, const double *X, double *ghost,
+                 double *send_buffer, double *Y, Metrics *metrics) {
+    int nreq = 0;
+    MPI_Request *requests = malloc((ex->recv_neighbors + ex->send_neighbors + 1) * sizeof(MPI_Request));
+
+    double start_time = MPI_Wtime();
+    trace_begin("intercambio");
+    for (int i = 0; i < ex->recv_neighbors; i++) {
+        MPI_Irecv(ghost + (size_t)ex->recv_offsets[i] * k, ex->recv_counts[i] * k, MPI_DOUBLE,
+                  ex->recv_ranks[i], EXCHANGE_TAG, MPI_COMM_WORLD, &requests[nreq++]);
+        metrics->bytes_received += (long)ex->recv_counts[i] * k * sizeof(double);
+    }
+    for (int i = 0; i < ex->total_send; i++) {
+        memcpy(send_buffer + (size_t)i * k, X + (size_t)ex->send_index[i] * k, k * sizeof(double));
+    }
+    for (int i = 0; i < ex->send_neighbors; i++) {
+        MPI_Isend(send_buffer + (size_t)ex->send_offsets[i] * k, ex->send_counts[i] * k, MPI_DOUBLE,
+                  ex->send_ranks[i], EXCHANGE_TAG, MPI_COMM_WORLD, &requests[nreq++]);
+        metrics->bytes_sent += (long)ex->send_counts[i] * k * sizeof(double);
+    }
+    trace_end();
+    metrics->comm_time += MPI_Wtime() - start_time;
+
+    // Parte local
+    start_time = MPI_Wtime();
+    trace_begin("local");
+    csr_multiply(A->rows, A->local_ptr, A->local_col, A->local_val, k, X, Y, 0);
+    trace_end();
+    metrics->comp_time += MPI_Wtime() - start_time;
+
+    start_time = MPI_Wtime();
+    trace_begin("intercambio");
+    MPI_Waitall(nreq, requests, MPI_STATUSES_IGNORE);
+    trace_end();
+    metrics->comm_time += MPI_Wtime() - start_time;
+
+    // Parte remota
+    start_time = MPI_Wtime();
+    trace_begin("remota");
+    csr_multiply(A->rows, A->remote_ptr, A->remote_col, A->remote_val, k, ghost, Y, 1);
+    trace_end();
+    metrics->comp_time += MPI_Wtime() - start_time;
+    metrics->flops += 2.0 * A->local_nnz * k;
+
+    free(requests);
+}
+
+// Origen independiente del reparto para verificar el producto: la malla del
+// Laplaciano o las entradas tal como las leyó cada proceso del archivo,
+// antes de enviarlas a los dueños y de separar la parte local y la remota
+typedef struct {
+    long grid;              // Lado de la malla (0 si la matriz viene de un archivo)
+    const MMEntry *entries; // Entradas leídas por este proceso
+    long count;
+    int symmetry;
+} Reference;
+
+// Valor esperado de la fila global 'row' del Laplaciano en la columna j,
+// evaluando el estencil de 5 puntos a partir de (i, j) de la malla
+static void laplacian_expected(long g, long row, int j, double *expected, double *magnitude) {
+    long i = row / g, c = row % g;
+    double terms[5];
+    int t = 0;
+    terms[t++] = 4.0 * dense_value(row, j);
+    if (i > 0)     terms[t++] = -dense_value(row - g, j);
+    if (c > 0)     terms[t++] = -dense_value(row - 1, j);
+    if (c < g - 1) terms[t++] = -dense_value(row + 1, j);
+    if (i < g - 1) terms[t++] = -dense_value(row + g, j);
+    *expected = *magnitude = 0.0;
+    for (int p = 0; p < t; p++) {
+        *expected += terms[p];
+        *magnitude += fabs(terms[p]);
+    }
+}
+
+// Valores esperados de la columna j para las filas propias (pares valor y
+// magnitud en 'local'): cada proceso suma los términos de sus entradas en
+// un vector global de n pares y MPI_Reduce_scatter entrega a cada dueño los
+// de sus filas. Usa 2n valores por proceso, solo al verificar.
+static void entries_expected(const DistMatrix *A, const Reference *ref, int j, double *global, double *local) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    memset(global, 0, 2 * (size_t)A->n * sizeof(double));
+    for (long e = 0; e < ref->count; e++) {
+        const MMEntry *entry = &ref->entries[e];
+        double term = entry->val * dense_value(entry->col, j);
+        global[2 * entry->row] += term;
+        global[2 * entry->row + 1] += fabs(term);
+        if (ref->symmetry != 0 && entry->row != entry->col) {
+            term = ref->symmetry * entry->val * dense_value(entry->row, j);
+            global[2 * entry->col] += term;
+            global[2 * entry->col + 1] += fabs(term);
+        }
+    }
+
+    int *counts = malloc(size * sizeof(int));
+    for (int r = 0; r < size; r++) counts[r] = (int)(2 * (A->row_starts[r + 1] - A->row_starts[r]));
+    MPI_Reduce_scatter(global, local, counts, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    free(counts);
+}
+
+// Comparar Y con el producto calculado desde el origen de la matriz, sin
+// usar la parte local y remota ni los fantasmas
+static long check_product(const DistMatrix *A, const Reference *ref, int k, const double *Y) {
+    long errors = 0;
+    double *global = NULL, *local = NULL;
+    if (ref->grid == 0) {
+        global = malloc((2 * (size_t)A->n + 1) * sizeof(double));
+        local = malloc((2 * (size_t)A->rows + 1) * sizeof(double));
+        if (global == NULL || local == NULL) {
+            fprintf(stderr, "No se pudo asignar memoria para verificar el producto\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    for (int j = 0; j < k; j++) {
+        if (ref->grid == 0) entries_expected(A, ref, j, global, local);
+        for (int r = 0; r < A->rows; r++) {
+            double expected, magnitude;
+            if (ref->grid > 0) {
+                laplacian_expected(ref->grid, A->first_row + r, j, &expected, &magnitude);
+            } else {
+                expected = local[2 * r];
+                magnitude = local[2 * r + 1];
+            }
+            if (fabs(Y[(size_t)r * k + j] - expected) > CHECK_TOLERANCE * (magnitude + 1.0)) errors++;
+        }
+    }
+    free(global);
+    free(local);
+    return errors;
+}
+
+// Ejecutar 'repetitions' productos con k columnas y mostrar las métricas
+static void run_product(const DistMatrix *A, const Exchange *ex, const Reference *ref, int k, int repetitions,
+                        int check, const char *label, int rank) {
+    double *X = malloc(((size_t)A->rows * k + 1) * sizeof(double));
+    double *Y = malloc(((size_t)A->rows * k + 1) * sizeof(double));
+    double *ghost = malloc(((size_t)A->ghosts * k + 1) * sizeof(double));
+    double *send_buffer = malloc(((size_t)ex->total_send * k + 1) * sizeof(double));
+    if (X == NULL || Y == NULL || ghost == NULL || send_buffer == NULL) {
+        fprintf(stderr, "Proceso %d: no se pudo asignar memoria para %s\n", rank, label);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int r = 0; r < A->rows; r++) {
+        for (int j = 0; j < k; j++) X[(size_t)r * k + j] = dense_value(A->first_row + r, j);
+    }
+
+    Metrics metrics = {0};
+    double *samples = malloc(repetitions * sizeof(double));
+    double *max_samples = malloc(repetitions * sizeof(double));
+    MPI_Barrier(MPI_COMM_WORLD);
+    for (int it = 0; it < repetitions; it++) {
+        double start = MPI_Wtime();
+        spmm(A, ex, k, X, ghost, send_buffer, Y, &metrics);
+        samples[it] = MPI_Wtime() - start;
+    }
+
+    // Cada repetición dura lo que el proceso más lento
+    MPI_Reduce(samples, max_samples, repetitions, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        char config[32];
+        snprintf(config, sizeof(config), "k=%d", k);
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+        BenchInfo info = { "sparse_mpi", label, config, size, 1, (double)A->nnz, 2.0 * A->nnz * k, "GFLOP/s" };
+        bench_report(&info, max_samples, repetitions);
+    }
+    free(samples);
+    free(max_samples);
+
+    if (check) {
+        long errors = check_product(A, ref, k, Y), total_errors;
+        MPI_Reduce(&errors, &total_errors, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            if (total_errors == 0) printf("Verificación %s: correcta\n", label);
+            else printf("Verificación %s: %ld elementos incorrectos\n", label, total_errors);
+        }
+    }
+
+    struct rusage usage_stats;
+    getrusage(RUSAGE_SELF, &usage_stats);
+
+    printf(">>> Proceso [%d] Reporte de Métricas (%s) <<<\n", rank, label);
+    printf("Memoria Máxima Usada: %ld KB\n", usage_stats.ru_maxrss);
+    printf("Tiempo de Cómputo: %.6f segundos\n", metrics.comp_time);
+    printf("Tiempo de Comunicación: %.6f segundos\n", metrics.comm_time);
+    printf("Rendimiento: %.3f GFLOP/s\n", metrics.comp_time > 0 ? metrics.flops / metrics.comp_time * 1e-9 : 0.0);
+    printf("Datos Enviados: %ld bytes\n", metrics.bytes_sent);
+    printf("Datos Recibidos: %ld bytes\n", metrics.bytes_received);
+    printf("-------------------------------\n\n");
+
+    free(X);
+    free(Y);
+    free(ghost);
+    free(send_buffer);
+}
+
+int main(int argc, char *argv[]) {
+    int world_rank, world_size;
+
+    // Inicializar MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    // Opciones: -f archivo Matrix Market, -g malla del Laplaciano,
+    // -k columnas de SpMM, -i repeticiones, -c verificar
+    const char *path = NULL;
+    long grid = DEFAULT_GRID;
+    int columns = DEFAULT_COLUMNS;
+    int repetitions = DEFAULT_REPETITIONS;
+    int check = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:g:k:i:c")) != -1) {
+        int valid = 1;
+        switch (opt) {
+            case 'f': path = optarg; break;
+            case 'g': grid = atol(optarg); valid = (grid > 0); break;
+            case 'k': columns = atoi(optarg); valid = (columns > 0); break;
+            case 'i': repetitions = atoi(optarg); valid = (repetitions > 0); break;
+            case 'c': check = 1; break;
+            default: valid = 0;
+        }
+        if (!valid) {
+            if (world_rank == 0) {
+                fprintf(stderr, "Uso: %s [-f matriz.mtx | -g malla] [-k columnas] [-i repeticiones] [-c]\n", argv[0]);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    DistMatrix A;
+    memset(&A, 0, sizeof(A));
+    A.row_starts = malloc((world_size + 1) * sizeof(long));
+    RowBlock block;
+    Reference ref = { grid, NULL, 0, 0 };
+    MMEntry *entries = NULL;
+    double load_start = MPI_Wtime();
+    trace_begin("carga");
+
+    if (path != NULL) {
+        MatrixMarket mm;
+        long count = 0, total;
+        int status = mm_open(path, &mm);
+        entries = (status == 0) ? mm_read_range(&mm, world_rank, world_size, &count) : NULL;
+        if (entries == NULL) {
+            fprintf(stderr, "Proceso %d: %s no es una matriz Matrix Market cuadrada en formato coordinate\n",
+                    world_rank, path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        fclose(mm.file);
+
+        // Entre todos los rangos debe haber tantas entradas como declara la
+        // cabecera
+        MPI_Allreduce(&count, &total, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if (total != mm.entries) {
+            if (world_rank == 0) {
+                fprintf(stderr, "Proceso %d: %s no es una matriz Matrix Market cuadrada en formato coordinate\n",
+                        world_rank, path);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+
+        long *prefix = mm_row_prefix(&mm, entries, count);
+        A.n = mm.rows;
+        A.nnz = prefix[mm.rows];
+        partition_by_nnz(A.n, A.nnz, world_size, mm_nnz_before, prefix, A.row_starts);
+        A.first_row = A.row_starts[world_rank];
+        A.rows = (int)(A.row_starts[world_rank + 1] - A.first_row);
+        mm_rows(&mm, entries, count, prefix, A.row_starts, world_size, A.first_row, A.rows, &block);
+        free(prefix);
+
+        // Las entradas leídas solo se conservan para verificar
+        if (check) {
+            ref = (Reference){ 0, entries, count, mm.symmetry };
+        } else {
+            free(entries);
+            entries = NULL;
+        }
+    } else {
+        A.n = grid * grid;
+        A.nnz = laplacian_nnz_before(A.n, &grid);
+        partition_by_nnz(A.n, A.nnz, world_size, laplacian_nnz_before, &grid, A.row_starts);
+        A.first_row = A.row_starts[world_rank];
+        A.rows = (int)(A.row_starts[world_rank + 1] - A.first_row);
+        laplacian_rows(grid, A.first_row, A.rows, &block);
+    }
+
+    build_matrix(&A, &block);
+    Exchange ex;
+    build_exchange(&A, world_rank, world_size, &ex);
+    trace_end();
+    double load_time = MPI_Wtime() - load_start;
+
+    // Equilibrio del reparto: máximo de no nulos por proceso frente a la media
+    long max_nnz;
+    MPI_Reduce(&A.local_nnz, &max_nnz, 1, MPI_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (world_rank == 0) {
+        if (path != NULL) printf("Matriz %s: %ld filas, %ld no nulos\n", path, A.n, A.nnz);
+        else printf("Laplaciano 2D de %ldx%ld: %ld filas, %ld no nulos\n", grid, grid, A.n, A.nnz);
+        printf("Reparto por no nulos: máximo %ld por proceso (%.3f veces la media), carga en %.3f segundos\n",
+               max_nnz, (double)max_nnz * world_size / (A.nnz > 0 ? A.nnz : 1), load_time);
+    }
+    printf("Proceso %d: filas %ld-%ld, %ld no nulos, %d columnas remotas de %d vecinos\n",
+           world_rank, A.first_row, A.first_row + A.rows - 1, A.local_nnz, A.ghosts, ex.recv_neighbors);
+
+    run_product(&A, &ex, &ref, 1, repetitions, check, "SpMV", world_rank);
+    run_product(&A, &ex, &ref, columns, repetitions, check, "SpMM", world_rank);
+
+    // Esperar a que el usuario presione Enter solo en ejecuciones
+    // interactivas, para no bloquear trabajos por lotes
+    if (world_rank == 0 && argc == 1 && isatty(STDIN_FILENO)) {
+        printf("\nPresione Enter para finalizar...");
+        getchar();
+    }
+
+    free(entries);
+    free(A.row_starts);
+    free(A.local_ptr);
+    free(A.local_col);
+    free(A.local_val);
+    free(A.remote_ptr);
+    free(A.remote_col);
+    free(A.remote_val);
+    free(A.ghost_global);
+    free(ex.recv_ranks);
+    free(ex.recv_counts);
+    free(ex.recv_offsets);
+    free(ex.send_ranks);
+    free(ex.send_counts);
+    free(ex.send_offsets);
+    free(ex.send_index);
+
+    // Finalizar MPI
+    MPI_Finalize();
+    return 0;
+}
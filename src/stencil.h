@@ -0,0 +1,379 @@
+// stencil.h
+// Motor de filtros de convolución (plantillas o "stencils") sobre imágenes
+// en gris, para radios de hasta STENCIL_MAX_RADIUS. Cada filtro se describe
+// por la matriz de pesos de uno o dos núcleos; al prepararlo se detecta cómo
+// aplicar cada núcleo:
+//   - caja (todos los pesos iguales): sumas deslizantes por columna y por
+//     fila, con un costo por píxel que no depende del radio;
+//   - separable (matriz de rango 1, K[i][j] = columna[i] * fila[j]): una
+//     pasada vertical y otra horizontal, O(2r) por píxel en lugar de O(r^2);
+//   - directa: suma de los pesos no nulos de la ventana.
+// Las filas en gris se obtienen bajo demanda con una función del programa
+// y se guardan en un búfer circular de 2r + 1 filas. Los bordes de la
+// imagen se replican. stencil_start y stencil_step calculan las filas de una
+// banda una a una; pipeline.h las convierte a bytes y encadena filtros.
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define STENCIL_MAX_RADIUS 15
+#define STENCIL_MAX_SIZE (2 * STENCIL_MAX_RADIUS + 1)
+
+// Forma de aplicar un núcleo
+enum { STENCIL_DIRECT, STENCIL_SEPARABLE, STENCIL_BOX };
+
+// Conversión del resultado a un byte: valor saturado, valor absoluto
+// saturado o magnitud sqrt(a^2 + b^2) de dos núcleos (gradiente)
+enum { STENCIL_VALUE, STENCIL_ABSOLUTE, STENCIL_MAGNITUDE };
+
+typedef struct {
+    float weights[STENCIL_MAX_SIZE * STENCIL_MAX_SIZE]; // size x size, fila a fila
+    int method;
+    float column[STENCIL_MAX_SIZE];   // núcleo separable: K[i][j] = column[i] * row[j]
+    float row[STENCIL_MAX_SIZE];
+    float boxWeight;                  // peso común de un núcleo de caja
+    int taps;                         // pesos no nulos (aplicación directa)
+    short tapRow[STENCIL_MAX_SIZE * STENCIL_MAX_SIZE];
+    short tapCol[STENCIL_MAX_SIZE * STENCIL_MAX_SIZE];
+    float tapWeight[STENCIL_MAX_SIZE * STENCIL_MAX_SIZE];
+} StencilKernel;
+
+typedef struct {
+    char name[32];        // nombre apto para archivos y reportes
+    int radius, size;
+    int kernels;          // 1, o 2 para la magnitud del gradiente
+    int output;
+    StencilKernel kernel[2];
+} Stencil;
+
+// Detectar la forma de aplicar un núcleo de size x size pesos
+static void stencil_prepare_kernel(StencilKernel *k, int size) {
+    int n = size * size;
+    float largest = 0.0f;
+    int pivot = 0, uniform = 1;
+    for (int i = 0; i < n; i++) {
+        if (fabsf(k->weights[i]) > largest) {
+            largest = fabsf(k->weights[i]);
+            pivot = i;
+        }
+        if (k->weights[i] != k->weights[0]) uniform = 0;
+    }
+
+    k->taps = 0;
+    for (int i = 0; i < n; i++) {
+        if (k->weights[i] == 0.0f) continue;
+        k->tapRow[k->taps] = (short)(i / size);
+        k->tapCol[k->taps] = (short)(i % size);
+        k->tapWeight[k->taps] = k->weights[i];
+        k->taps++;
+    }
+
+    if (uniform && largest > 0.0f) {
+        k->method = STENCIL_BOX;
+        k->boxWeight = k->weights[0];
+        return;
+    }
+
+    // Rango 1: cada fila es múltiplo de la fila del pivote
+    k->method = STENCIL_DIRECT;
+    if (largest == 0.0f) return;
+    int p = pivot / size, q = pivot % size;
+    for (int i = 0; i < size; i++) k->column[i] = k->weights[i * size + q];
+    for (int j = 0; j < size; j++) k->row[j] = k->weights[p * size + j] / k->weights[pivot];
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            if (fabsf(k->weights[i * size + j] - k->column[i] * k->row[j]) > 1e-6f * largest) return;
+        }
+    }
+    k->method = STENCIL_SEPARABLE;
+
+    // Con pesos enteros se usan factores enteros (la fila del pivote
+    // dividida por el mcd de sus pesos) para que las sumas sean exactas
+    for (int i = 0; i < n; i++) {
+        if (k->weights[i] != floorf(k->weights[i])) return;
+    }
+    int g = 0;
+    for (int j = 0; j < size; j++) {
+        int a = abs((int)k->weights[p * size + j]);
+        while (a != 0) {
+            int t = g % a;
+            g = a;
+            a = t;
+        }
+    }
+    for (int j = 0; j < size; j++) k->row[j] = k->weights[p * size + j] / g;
+    for (int i = 0; i < size; i++) k->column[i] = roundf(k->weights[i * size + q] * g / k->weights[pivot]);
+}
+
+static void stencil_init(Stencil *s, const char *name, int radius, int kernels, int output) {
+    memset(s, 0, sizeof(Stencil));
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->radius = radius;
+    s->size = 2 * radius + 1;
+    s->kernels = kernels;
+    s->output = output;
+}
+
+// Gradiente 3x3: Gx = suavizado^T x [-1 0 1] y Gy su transpuesta
+static void stencil_gradient(Stencil *s, const char *name, const float smooth[3]) {
+    static const float derivative[3] = { -1, 0, 1 };
+    stencil_init(s, name, 1, 2, STENCIL_MAGNITUDE);
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            s->kernel[0].weights[i * 3 + j] = smooth[i] * derivative[j];
+            s->kernel[1].weights[i * 3 + j] = derivative[i] * smooth[j];
+        }
+    }
+}
+
+// Construir un filtro a partir de su descripción:
+//   sobel | scharr | prewitt          magnitud del gradiente 3x3
+//   laplace                           |laplaciano| 3x3 (4 vecinos)
+//   gauss[:radio[:sigma]]             gaussiano (radio 2, sigma radio / 2)
+//   box[:radio]                       media en una caja (radio 1)
+//   matriz:lado:p1,p2,...             pesos arbitrarios de lado x lado (lado
+//                                     impar); si suman 0 se toma el valor
+//                                     absoluto del resultado
+// Devuelve 0 si la descripción es válida.
+static int stencil_parse(const char *spec, Stencil *s) {
+    char name[16] = "";
+    int consumed = 0;
+    sscanf(spec, "%15[a-z]%n", name, &consumed);
+    const char *args = spec + consumed;
+    if (*args == ':') args++;
+    else if (*args != '\0') return -1;
+
+    if (strcmp(name, "sobel") == 0 || strcmp(name, "scharr") == 0 || strcmp(name, "prewitt") == 0) {
+        static const float sobel[3] = { 1, 2, 1 }, scharr[3] = { 3, 10, 3 }, prewitt[3] = { 1, 1, 1 };
+        stencil_gradient(s, name, name[1] == 'o' ? sobel : (name[1] == 'c' ? scharr : prewitt));
+    } else if (strcmp(name, "laplace") == 0) {
+        static const float laplace[9] = { 0, 1, 0, 1, -4, 1, 0, 1, 0 };
+        stencil_init(s, name, 1, 1, STENCIL_ABSOLUTE);
+        memcpy(s->kernel[0].weights, laplace, sizeof(laplace));
+    } else if (strcmp(name, "gauss") == 0) {
+        int radius = 2;
+        float sigma = 0.0f;
+        if (*args != '\0' && sscanf(args, "%d:%f", &radius, &sigma) < 1) return -1;
+        if (radius < 1 || radius > STENCIL_MAX_RADIUS || sigma < 0.0f) return -1;
+        char label[32];
+        if (sigma == 0.0f) snprintf(label, sizeof(label), "gauss%d", radius);
+        else snprintf(label, sizeof(label), "gauss%d-%g", radius, sigma);
+        if (sigma == 0.0f) sigma = radius / 2.0f;
+
+        float g[STENCIL_MAX_SIZE], total = 0.0f;
+        for (int i = -radius; i <= radius; i++) {
+            g[i + radius] = expf(-(float)(i * i) / (2.0f * sigma * sigma));
+            total += g[i + radius];
+        }
+        stencil_init(s, label, radius, 1, STENCIL_VALUE);
+        for (int i = 0; i < s->size; i++) {
+            for (int j = 0; j < s->size; j++) {
+                s->kernel[0].weights[i * s->size + j] = g[i] * g[j] / (total * total);
+            }
+        }
+    } else if (strcmp(name, "box") == 0) {
+        int radius = 1;
+        if (*args != '\0' && sscanf(args, "%d", &radius) != 1) return -1;
+        if (radius < 1 || radius > STENCIL_MAX_RADIUS) return -1;
+        char label[32];
+        snprintf(label, sizeof(label), "box%d", radius);
+        stencil_init(s, label, radius, 1, STENCIL_VALUE);
+        for (int i = 0; i < s->size * s->size; i++) {
+            s->kernel[0].weights[i] = 1.0f / (s->size * s->size);
+        }
+    } else if (strcmp(name, "matriz") == 0) {
+        int side = 0, used = 0;
+        if (sscanf(args, "%d:%n", &side, &used) != 1 || used == 0) return -1;
+        if (side < 1 || side % 2 == 0 || side > STENCIL_MAX_SIZE) return -1;
+        stencil_init(s, "matriz", side / 2, 1, STENCIL_VALUE);
+        snprintf(s->name, sizeof(s->name), "matriz%dx%d", side, side);
+        const char *text = args + used;
+        float total = 0.0f;
+        for (int i = 0; i < side * side; i++) {
+            char *end;
+            s->kernel[0].weights[i] = strtof(text, &end);
+            if (end == text || (i < side * side - 1 && *end != ',')) return -1;
+            total += s->kernel[0].weights[i];
+            text = end + 1;
+        }
+        if (total == 0.0f) s->output = STENCIL_ABSOLUTE;
+    } else {
+        return -1;
+    }
+
+    for (int k = 0; k < s->kernels; k++) {
+        stencil_prepare_kernel(&s->kernel[k], s->size);
+    }
+    return 0;
+}
+
+// Nombre de la forma de aplicar cada núcleo, para los reportes
+static const char *stencil_method_name(const Stencil *s) {
+    static const char *names[] = { "directo", "separable", "caja" };
+    return names[s->kernel[0].method];
+}
+
+// Cargar en 'gray' (width bytes) la fila 'y' de la imagen en gris
+typedef void (*stencil_load_fn)(void *ctx, int y, unsigned char *gray);
+
+// Estado de trabajo de un hilo: búfer circular de filas con bordes
+// replicados y resultados intermedios de una fila
+typedef struct {
+    const Stencil *stencil;
+    int width, height, padded;   // padded = width + 2r
+    unsigned char *ring;         // 2r + 1 filas de 'padded' bytes
+    float *vertical;             // pasada vertical (padded)
+    float *result[2];            // resultado de cada núcleo (width)
+    int *sums;                   // sumas por columna de la caja (padded)
+    int box;                     // algún núcleo se aplica como caja
+    int first, next;             // primera fila de la banda y siguiente a calcular
+} StencilWorker;
+
+static inline size_t stencil_worker_bytes(const Stencil *s, int width) {
+    size_t padded = (size_t)width + 2 * s->radius;
+    return padded * s->size + padded * (sizeof(float) + sizeof(int)) + 2 * (size_t)width * sizeof(float);
+}
+
+static StencilWorker *stencil_worker_new(const Stencil *s, int width, int height) {
+    StencilWorker *w = malloc(sizeof(StencilWorker));
+    w->stencil = s;
+    w->width = width;
+    w->height = height;
+    w->padded = width + 2 * s->radius;
+    w->ring = malloc((size_t)w->padded * s->size);
+    w->vertical = malloc((size_t)w->padded * sizeof(float));
+    w->result[0] = malloc((size_t)width * sizeof(float));
+    w->result[1] = malloc((size_t)width * sizeof(float));
+    w->sums = malloc((size_t)w->padded * sizeof(int));
+    w->box = 0;
+    for (int k = 0; k < s->kernels; k++) w->box |= (s->kernel[k].method == STENCIL_BOX);
+    if (w->ring == NULL || w->vertical == NULL || w->result[0] == NULL || w->result[1] == NULL || w->sums == NULL) {
+        fprintf(stderr, "No se pudo asignar memoria para el filtro %s\n", s->name);
+        exit(1);
+    }
+    return w;
+}
+
+static void stencil_worker_free(StencilWorker *w) {
+    free(w->ring);
+    free(w->vertical);
+    free(w->result[0]);
+    free(w->result[1]);
+    free(w->sums);
+    free(w);
+}
+
+// Fila del búfer circular que corresponde a la fila (sin recortar) 'y'
+static inline unsigned char *stencil_ring_row(const StencilWorker *w, int y) {
+    int size = w->stencil->size;
+    return w->ring + (size_t)(((y % size) + size) % size) * w->padded;
+}
+
+// Cargar la fila 'y', recortada a la imagen, y replicar sus bordes
+static void stencil_load(StencilWorker *w, stencil_load_fn load, void *ctx, int y) {
+    int r = w->stencil->radius;
+    unsigned char *row = stencil_ring_row(w, y);
+    load(ctx, y < 0 ? 0 : (y >= w->height ? w->height - 1 : y), row + r);
+    memset(row, row[r], r);
+    memset(row + r + w->width, row[r + w->width - 1], r);
+}
+
+// Aplicar el núcleo 'k' a la fila 'y' (su ventana ya está en el búfer)
+static void stencil_apply(StencilWorker *w, const StencilKernel *k, int y, float *result) {
+    int r = w->stencil->radius, size = w->stencil->size, width = w->width;
+
+    if (k->method == STENCIL_BOX) {
+        // Suma deslizante de las sumas por columna
+        int sum = 0;
+        for (int j = 0; j < size; j++) sum += w->sums[j];
+        result[0] = sum * k->boxWeight;
+        for (int x = 1; x < width; x++) {
+            sum += w->sums[x + size - 1] - w->sums[x - 1];
+            result[x] = sum * k->boxWeight;
+        }
+        return;
+    }
+
+    for (int x = 0; x < width; x++) result[x] = 0.0f;
+
+    if (k->method == STENCIL_SEPARABLE) {
+        float *v = w->vertical;
+        for (int x = 0; x < w->padded; x++) v[x] = 0.0f;
+        for (int i = 0; i < size; i++) {
+            float c = k->column[i];
+            if (c == 0.0f) continue;
+            const unsigned char *src = stencil_ring_row(w, y - r + i);
+            for (int x = 0; x < w->padded; x++) v[x] += c * src[x];
+        }
+        for (int j = 0; j < size; j++) {
+            float c = k->row[j];
+            if (c == 0.0f) continue;
+            for (int x = 0; x < width; x++) result[x] += c * v[x + j];
+        }
+        return;
+    }
+
+    for (int t = 0; t < k->taps; t++) {
+        const unsigned char *src = stencil_ring_row(w, y - r + k->tapRow[t]) + k->tapCol[t];
+        float c = k->tapWeight[t];
+        for (int x = 0; x < width; x++) result[x] += c * src[x];
+    }
+}
+
+// Convertir el resultado de los núcleos en un píxel a un byte
+static inline int stencil_value(const Stencil *s, float a, float b) {
+    if (s->output == STENCIL_MAGNITUDE) {
+        // Misma saturación y truncamiento que el Sobel clásico
+        float sum = a * a + b * b;
+        return (sum >= 65536.0f) ? 255 : (int)sqrtf(sum);
+    }
+    float v = (s->output == STENCIL_ABSOLUTE) ? fabsf(a) : a;
+    return (v <= 0.0f) ? 0 : (v >= 255.0f ? 255 : (int)(v + 0.5f));
+}
+
+// Empezar una banda en la fila y0: cargar las 2r filas anteriores a la
+// ventana de y0 + r. Las filas se piden a 'load' en orden creciente, desde
+// y0 - r hasta y1 + r - 1 para una banda [y0, y1), recortadas a la imagen
+// (pipeline.h encadena etapas con esta garantía).
+static void stencil_start(StencilWorker *w, stencil_load_fn load, void *ctx, int y0) {
+    int r = w->stencil->radius;
+
+    for (int y = y0 - r; y < y0 + r; y++) stencil_load(w, load, ctx, y);
+    if (w->box) {
+        memset(w->sums, 0, (size_t)w->padded * sizeof(int));
+        for (int y = y0 - r; y < y0 + r; y++) {
+            const unsigned char *src = stencil_ring_row(w, y);
+            for (int x = 0; x < w->padded; x++) w->sums[x] += src[x];
+        }
+    }
+    w->first = y0;
+    w->next = y0;
+}
+
+// Calcular la siguiente fila de la banda en w->result y devolver su índice
+static int stencil_step(StencilWorker *w, stencil_load_fn load, void *ctx) {
+    const Stencil *s = w->stencil;
+    int r = s->radius, y = w->next++;
+
+    // La fila que sale de la ventana ocupa la posición de la que entra
+    if (w->box && y > w->first) {
+        const unsigned char *old = stencil_ring_row(w, y - r - 1);
+        for (int x = 0; x < w->padded; x++) w->sums[x] -= old[x];
+    }
+    stencil_load(w, load, ctx, y + r);
+    if (w->box) {
+        const unsigned char *src = stencil_ring_row(w, y + r);
+        for (int x = 0; x < w->padded; x++) w->sums[x] += src[x];
+    }
+
+    for (int k = 0; k < s->kernels; k++) {
+        stencil_apply(w, &s->kernel[k], y, w->result[k]);
+    }
+    return y;
+}
+
+#endif // STENCIL_H
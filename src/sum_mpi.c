@@ -1,46 +1,151 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 #include <mpi.h>
 
+#include "reduce.h"
+#include "bench.h"
+#include "mpi_trace.h"
+
 #define max_rows 100000
 #define send_data_tag 2001
 #define return_data_tag 2002
 
+#define CHUNK_ELEMS (1 << 16)   // Elementos generados o leídos por bloque
+#define VALUE_PERIOD 1000000    // Los valores generados van de 1 a VALUE_PERIOD
+
 int array[max_rows];
 int array2[max_rows];
 
-int main(int argc, char **argv)
-{
+// Valor del elemento i de los datos generados: i + 1, como en el modo
+// clásico, repitiéndose cada VALUE_PERIOD elementos para que la suma de
+// miles de millones de elementos quepa en 64 bits
+static inline int element_value(int64_t i) {
+    return (int)(i % VALUE_PERIOD) + 1;
+}
+
+// Suma esperada de los n primeros elementos generados
+static int64_t expected_sum(int64_t n) {
+    int64_t periods = n / VALUE_PERIOD, rest = n % VALUE_PERIOD;
+    int64_t period_sum = (int64_t)VALUE_PERIOD * (VALUE_PERIOD + 1) / 2;
+    return periods * period_sum + rest * (rest + 1) / 2;
+}
+
+// Suma de los cuadrados de los n primeros elementos generados
+static long double expected_sum_squares(int64_t n) {
+    int64_t periods = n / VALUE_PERIOD, rest = n % VALUE_PERIOD;
+    long double p = VALUE_PERIOD, r = rest;
+    return periods * (p * (p + 1) * (2 * p + 1) / 6) + r * (r + 1) * (2 * r + 1) / 6;
+}
+
+// Generar los elementos [first, first + count) en el búfer. Con double el
+// elemento i vale element_value(i) / 10, que no es exacto en binario y
+// permite comparar la suma directa con la compensada.
+static void generate_chunk(ReduceType type, int64_t first, int count, void *data) {
+    int value = element_value(first);
+    for (int i = 0; i < count; i++) {
+        if (type == REDUCE_INT32) ((int32_t *)data)[i] = value;
+        else if (type == REDUCE_INT64) ((int64_t *)data)[i] = value;
+        else ((double *)data)[i] = value / 10.0;
+        value = (value == VALUE_PERIOD) ? 1 : value + 1;
+    }
+}
+
+static const char *type_names[] = { "int", "int64", "double" };
+static const char *op_names[] = { "sum", "kahan", "min", "max", "argmax", "mean", "var" };
+
+static int select_name(const char *name, const char **names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Valor principal del resultado: suma, mínimo, máximo, media o varianza
+// (poblacional), y la posición del máximo en *index con argmax
+static long double state_value(const reduce_state *s, int64_t *index) {
+    int isDouble = (s->type == REDUCE_DOUBLE);
+    *index = -1;
+    switch (s->op) {
+        case REDUCE_KAHAN:
+            if (isDouble) return (long double)s->kahan.sum + s->kahan.c;
+            return s->i;
+        case REDUCE_ARGMAX:
+            *index = isDouble ? s->loc_d.index : s->loc_i.index;
+            return isDouble ? s->loc_d.value : s->loc_i.value;
+        case REDUCE_MEAN:
+            return s->stats.mean;
+        case REDUCE_VAR:
+            return (s->stats.n > 0) ? s->stats.m2 / s->stats.n : 0.0;
+        default:
+            return isDouble ? s->d : s->i;
+    }
+}
+
+// Valor esperado de la operación sobre los n primeros elementos generados
+static long double expected_value(ReduceType type, ReduceOp op, int64_t n, int64_t *index) {
+    long double scale = (type == REDUCE_DOUBLE) ? 0.1L : 1.0L;
+    long double top = (n < VALUE_PERIOD) ? n : VALUE_PERIOD;
+    long double mean = (long double)expected_sum(n) / n;
+    *index = (op == REDUCE_ARGMAX) ? (int64_t)top - 1 : -1;
+    switch (op) {
+        case REDUCE_SUM:
+        case REDUCE_KAHAN: return scale * expected_sum(n);
+        case REDUCE_MIN: return scale;
+        case REDUCE_MAX:
+        case REDUCE_ARGMAX: return scale * top;
+        case REDUCE_MEAN: return scale * mean;
+        default: return scale * scale * (expected_sum_squares(n) / n - mean * mean);
+    }
+}
+
+// Texto del resultado, con su posición si es argmax
+static void format_value(char *text, size_t size, const reduce_state *s) {
+    int64_t index;
+    long double value = state_value(s, &index);
+    int len;
+    if (s->type == REDUCE_DOUBLE || s->op == REDUCE_MEAN || s->op == REDUCE_VAR) {
+        len = snprintf(text, size, "%.17Lg", value);
+    } else {
+        len = snprintf(text, size, "%" PRId64, (int64_t)value);
+    }
+    if (index >= 0 && len >= 0 && (size_t)len < size) {
+        snprintf(text + len, size - len, " en la posición %" PRId64, index);
+    }
+}
+
+// Modo clásico: el proceso maestro reparte el arreglo con MPI_Send y
+// recibe las sumas parciales una a una. Si 'requested' es negativo el
+// número de elementos se pide por la entrada estándar.
+static void legacy_sum(int my_id, int num_procs, int64_t requested) {
     long int sum, partial_sum;
     MPI_Status status;
-    int my_id, root_process, ierr, i, num_rows, num_procs,
+    int root_process, ierr, i, num_rows,
         an_id, num_rows_to_receive, avg_rows_per_process,
         sender, num_rows_received, start_row, end_row, num_rows_to_send;
 
-    setbuf(stdout, NULL); // Deshabilitar el buffering de stdout
-
-    // Inicializar MPI
-    ierr = MPI_Init(&argc, &argv);
-
     root_process = 0;
 
-    // Obtener el ID del proceso y el número total de procesos
-    ierr = MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
-    ierr = MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
-
     // Sincronizar los procesos antes de interactuar con el usuario
     MPI_Barrier(MPI_COMM_WORLD);
 
     if (my_id == root_process) {
         // Proceso maestro
 
-        printf("Por favor, ingrese el número de elementos a sumar: ");
-        fflush(stdout); // Forzar el vaciado del buffer
-        scanf("%i", &num_rows);
+        if (requested >= 0) {
+            num_rows = (requested > max_rows) ? max_rows + 1 : (int)requested;
+        } else {
+            printf("Por favor, ingrese el número de elementos a sumar: ");
+            fflush(stdout); // Forzar el vaciado del buffer
+            if (scanf("%i", &num_rows) != 1) num_rows = 0;
+        }
 
         if (num_rows > max_rows) {
             printf("Demasiados números.\n");
-            exit(1);
+            MPI_Abort(MPI_COMM_WORLD, 1);
         }
 
         avg_rows_per_process = num_rows / num_procs;
@@ -113,9 +218,186 @@ int main(int argc, char **argv)
         ierr = MPI_Send(&partial_sum, 1, MPI_LONG, root_process,
                         return_data_tag, MPI_COMM_WORLD);
     }
+    (void)ierr;
+}
+
+int main(int argc, char **argv)
+{
+    int my_id, num_procs;
+
+    setbuf(stdout, NULL); // Deshabilitar el buffering de stdout
+
+    // Inicializar MPI
+    MPI_Init(&argc, &argv);
+
+    // Obtener el ID del proceso y el número total de procesos
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_id);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    // Opciones: -n elementos, -f archivo binario, -t tipo de los elementos,
+    // -r operación, -i repeticiones, -a resultado en todos los procesos
+    // (MPI_Allreduce), -l modo clásico
+    int64_t n = -1;
+    const char *path = NULL;
+    int all = 0, legacy = 0, repetitions = 1;
+    ReduceType type = REDUCE_INT32;
+    ReduceOp op = REDUCE_SUM;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:t:r:i:al")) != -1) {
+        int valid = 1, index;
+        switch (opt) {
+            case 'n': n = strtoll(optarg, NULL, 10); valid = (n >= 0); break;
+            case 'f': path = optarg; break;
+            case 't':
+                index = select_name(optarg, type_names, 3);
+                valid = (index >= 0);
+                if (valid) type = (ReduceType)index;
+                break;
+            case 'r':
+                index = select_name(optarg, op_names, 7);
+                valid = (index >= 0);
+                if (valid) op = (ReduceOp)index;
+                break;
+            case 'i': repetitions = atoi(optarg); valid = (repetitions > 0); break;
+            case 'a': all = 1; break;
+            case 'l': legacy = 1; break;
+            default: valid = 0;
+        }
+        if (!valid) {
+            if (my_id == 0) {
+                fprintf(stderr, "Uso: %s [-n elementos] [-f archivo] [-t int|int64|double] "
+                        "[-r sum|kahan|min|max|argmax|mean|var] [-i repeticiones] [-a] [-l]\n", argv[0]);
+            }
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    // Sin argumentos se mantiene el modo clásico interactivo; con -l -n el
+    // modo clásico no lee nada de la entrada estándar
+    if (legacy || argc == 1) {
+        legacy_sum(my_id, num_procs, n);
+        MPI_Finalize();
+        return 0;
+    }
+
+    const char *kernelName;
+    reduce_select(&kernelName);
+
+    int elem_size = (type == REDUCE_INT32) ? 4 : 8;
+    MPI_Datatype elem_type = (type == REDUCE_INT32) ? MPI_INT32_T : (type == REDUCE_INT64) ? MPI_INT64_T : MPI_DOUBLE;
+
+    // Cada proceso genera o lee su propio tramo de los datos, sin que el
+    // proceso maestro los reparta
+    MPI_File file = MPI_FILE_NULL;
+    if (path != NULL) {
+        if (MPI_File_open(MPI_COMM_WORLD, path, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+            if (my_id == 0) fprintf(stderr, "No se pudo abrir el archivo %s\n", path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        MPI_Offset file_size;
+        MPI_File_get_size(file, &file_size);
+        int64_t file_elems = file_size / elem_size;
+        if (n < 0 || n > file_elems) n = file_elems;
+    } else if (n < 0) {
+        n = max_rows;
+    }
+
+    int64_t start = n / num_procs * my_id + (my_id < n % num_procs ? my_id : n % num_procs);
+    int64_t count = n / num_procs + (my_id < n % num_procs ? 1 : 0);
+
+    void *chunk = malloc((size_t)CHUNK_ELEMS * elem_size);
+    if (chunk == NULL) {
+        fprintf(stderr, "Proceso %d: no se pudo asignar memoria\n", my_id);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Con varias repeticiones se conservan los tiempos de la más rápida
+    reduce_state partial, result;
+    double comp_time = 0.0, comm_time = 0.0;
+    double *samples = malloc(repetitions * sizeof(double));
+    for (int rep = 0; rep < repetitions; rep++) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double comp_start = MPI_Wtime();
+
+        // Reducción local por bloques: la memoria usada no depende de n
+        trace_begin("local");
+        reduce_init(&partial, type, op);
+        for (int64_t done = 0; done < count; ) {
+            int len = (count - done < CHUNK_ELEMS) ? (int)(count - done) : CHUNK_ELEMS;
+            if (file != MPI_FILE_NULL) {
+                MPI_File_read_at(file, (MPI_Offset)(start + done) * elem_size, chunk, len, elem_type, MPI_STATUS_IGNORE);
+            } else {
+                generate_chunk(type, start + done, len, chunk);
+            }
+            reduce_chunk(&partial, chunk, len, start + done);
+            done += len;
+        }
+        trace_end();
+
+        double comm_start = MPI_Wtime();
+
+        // Combinar los resultados parciales con una reducción en árbol
+        trace_begin("combinacion");
+        reduce_combine(&partial, &result, all, 0, MPI_COMM_WORLD);
+        trace_end();
+
+        double end = MPI_Wtime();
+        samples[rep] = end - comp_start;
+        if (rep == 0 || samples[rep] < comp_time + comm_time) {
+            comp_time = comm_start - comp_start;
+            comm_time = end - comm_start;
+        }
+    }
+
+    // Cada repetición dura lo que el proceso más lento
+    double *max_samples = malloc(repetitions * sizeof(double));
+    MPI_Reduce(samples, max_samples, repetitions, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (my_id == 0) {
+        char variant[32];
+        snprintf(variant, sizeof(variant), "%s/%s", op_names[op], type_names[type]);
+        BenchInfo info = { "sum_mpi", variant, path ? path : "generados", num_procs, 1,
+                           (double)n, (double)n * elem_size, "GB/s" };
+        bench_report(&info, max_samples, repetitions);
+    }
+    free(samples);
+    free(max_samples);
+
+    char text[96];
+    format_value(text, sizeof(text), &partial);
+    printf("Resultado parcial %s calculado por el proceso %d (%" PRId64 " elementos)\n", text, my_id, count);
+
+    // Tiempo del proceso más lento
+    double times[2] = { comp_time, comm_time }, max_times[2];
+    MPI_Reduce(times, max_times, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (my_id == 0) {
+        printf("Operación: %s sobre %s (núcleos %s)\n", op_names[op], type_names[type], kernelName);
+        format_value(text, sizeof(text), &result);
+        printf("El total general es: %s\n", text);
+        if (path == NULL && n > 0) {
+            // Los resultados enteros deben ser exactos; los de coma flotante
+            // se comparan con una referencia en long double
+            int64_t index, expected_index;
+            long double value = state_value(&result, &index);
+            long double expected = expected_value(type, op, n, &expected_index);
+            long double error = (expected != 0) ? fabsl((value - expected) / expected) : fabsl(value);
+            int exact = (type != REDUCE_DOUBLE && op != REDUCE_MEAN && op != REDUCE_VAR);
+            int correct = (index == expected_index) && (exact ? value == expected : error < 1e-6);
+            printf("Verificación: %s", correct ? "correcta" : "incorrecta");
+            if (!exact) printf(" (error relativo %.3Le)", error);
+            printf("\n");
+        }
+        printf("Tiempo de Cómputo: %.6f segundos\n", max_times[0]);
+        printf("Tiempo de Comunicación: %.6f segundos\n", max_times[1]);
+        printf("Elementos por segundo: %.3e\n", max_times[0] > 0 ? n / max_times[0] : 0.0);
+    }
+
+    if (file != MPI_FILE_NULL) MPI_File_close(&file);
+    free(chunk);
 
     // Finalizar MPI
-    ierr = MPI_Finalize();
+    MPI_Finalize();
 
     return 0;
 }